@@ -0,0 +1,61 @@
+#include "plumed/tools/Grid.h"
+#include "plumed/tools/File.h"
+#include "plumed/tools/Random.h"
+#include <vector>
+#include <string>
+#include <cmath>
+
+using namespace PLMD;
+
+// compare the batch interpolation with the single point one
+// for grids of dimension from one (specialized) to five (generic)
+int main () {
+  OFile out; out.open("output");
+  Random rnd;
+  for(unsigned dim=1; dim<=5; dim++) for(unsigned spline=0; spline<2; spline++) {
+      std::vector<std::string> names(dim),gmin(dim),gmax(dim),pmin(dim,"0."),pmax(dim,"0.");
+      std::vector<unsigned> nbin(dim,6);
+      std::vector<bool> isperiodic(dim,false);
+      for(unsigned j=0; j<dim; j++) {
+        names[j]="x"+std::to_string(j);
+        gmin[j]="0"; gmax[j]="2";
+      }
+// first dimension is periodic
+      isperiodic[0]=true; gmin[0]="-pi"; gmax[0]="pi"; pmin[0]="-pi"; pmax[0]="pi";
+      Grid grid("f",names,gmin,gmax,nbin,spline,true,true,isperiodic,pmin,pmax);
+      std::vector<double> x(dim),der(dim);
+      for(Grid::index_t i=0; i<grid.getSize(); i++) {
+        grid.getPoint(i,x);
+        double f=1.0;
+        for(unsigned j=0; j<dim; j++) f+=std::cos(x[j]+j);
+        for(unsigned j=0; j<dim; j++) der[j]=-std::sin(x[j]+j);
+        grid.setValueAndDerivatives(i,f,der);
+      }
+
+      const unsigned npoints=20;
+      std::vector<double> xx(npoints*dim),values(npoints),ders(npoints*dim),values2(npoints);
+      for(unsigned k=0; k<npoints; k++) {
+        xx[k*dim]=-M_PI+2*M_PI*rnd.RandU01();
+        for(unsigned j=1; j<dim; j++) xx[k*dim+j]=1.99*rnd.RandU01();
+      }
+      grid.getValuesAndDerivatives(npoints,&xx[0],&values[0],&ders[0]);
+      grid.getValuesAndDerivatives(npoints,&xx[0],&values2[0],NULL);
+
+      double maxdiff=0.0;
+      for(unsigned k=0; k<npoints; k++) {
+        for(unsigned j=0; j<dim; j++) x[j]=xx[k*dim+j];
+        double f=grid.getValueAndDerivatives(x,der);
+        maxdiff=std::max(maxdiff,std::fabs(f-values[k]));
+        maxdiff=std::max(maxdiff,std::fabs(grid.getValue(x)-values2[k]));
+        for(unsigned j=0; j<dim; j++) maxdiff=std::max(maxdiff,std::fabs(der[j]-ders[k*dim+j]));
+      }
+      out.printf("dimension %u spline %u maximum difference %g\n",dim,spline,maxdiff);
+      for(unsigned k=0; k<3; k++) {
+        out.printf("  %10.6f",values[k]);
+        for(unsigned j=0; j<dim; j++) out.printf(" %10.6f",ders[k*dim+j]);
+        out.printf("\n");
+      }
+    }
+  out.close();
+  return 0;
+}
@@ -0,0 +1,36 @@
+#include "plumed/lepton/Lepton.h"
+#include "plumed/tools/File.h"
+#include <vector>
+#include <string>
+#include <cmath>
+
+using namespace PLMD;
+
+// compare the batch evaluation of lepton expressions with the single point one,
+// for expressions using both vectorized and generic operations
+int main () {
+  OFile out; out.open("output");
+  std::vector<std::string> funcs= {
+    "x+y","x*y-3*x","x/(1+y^2)","sqrt(x^2+y^2)","exp(-x)*log(1+y)","1/(1+x^6)",
+    "tanh(x)-abs(y)","sin(x)*cos(y)","step(x-y)*x^1.5","min(x,y)+max(x,2)","erf(x)","0*x+y"
+  };
+  const unsigned n=150;
+  std::vector<double> x(n),y(n),result(n);
+  for(unsigned i=0; i<n; i++) {
+    x[i]=0.01+0.02*i;
+    y[i]=2.0-0.013*i;
+  }
+  for(const auto & f : funcs) {
+    lepton::CompiledExpression ce=lepton::Parser::parse(f).optimize().createCompiledExpression();
+    std::vector<const double*> values;
+    for(const auto & v : ce.getVariables()) values.push_back(v=="x" ? x.data() : y.data());
+    ce.evaluate(n,values.data(),result.data());
+    double maxdiff=0.0;
+    for(unsigned i=0; i<n; i++) {
+      for(const auto & v : ce.getVariables()) ce.getVariableReference(v)=(v=="x" ? x[i] : y[i]);
+      maxdiff=std::max(maxdiff,std::fabs(ce.evaluate()-result[i]));
+    }
+    out.printf("%s %g %g %g\n",f.c_str(),result[0],result[n-1],maxdiff);
+  }
+  return 0;
+}
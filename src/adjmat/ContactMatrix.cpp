@@ -136,7 +136,7 @@ double ContactMatrix::calculateWeight( const unsigned& taskCode, const double& w
 double ContactMatrix::compute( const unsigned& tindex, multicolvar::AtomValuePack& myatoms ) const {
   Vector distance = getSeparation( myatoms.getPosition(0), myatoms.getPosition(1) );
   double dfunc;
-  double sw = switchingFunction( getBaseColvarNumber( myatoms.getIndex(0) ), getBaseColvarNumber( myatoms.getIndex(1) ) - ncol_t ).calculate( distance.modulo(), dfunc );
+  double sw = switchingFunction( getBaseColvarNumber( myatoms.getIndex(0) ), getBaseColvarNumber( myatoms.getIndex(1) ) - ncol_t ).calculateSqr( distance.modulo2(), dfunc );
 
   if( !doNotCalculateDerivatives() ) {
     addAtomDerivatives( 1, 0, (-dfunc)*distance, myatoms );
@@ -155,7 +155,9 @@ void External::calculate()
 
   for(unsigned i=0; i<ncv; ++i) {cv[i]=getArgument(i);}
 
-  double ene=scale_*BiasGrid_->getValueAndDerivatives(cv,der);
+  double ene;
+  BiasGrid_->getValuesAndDerivatives(1,&cv[0],&ene,&der[0]);
+  ene*=scale_;
 
   setBias(ene);
 
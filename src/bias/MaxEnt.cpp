@@ -163,6 +163,7 @@ public:
   ~MaxEnt();
   void calculate();
   void update();
+  bool isHistoryDependent()const {return true;}
   void update_lambda();
   static void registerKeywords(Keywords& keys);
   void ReadLagrangians(IFile &ifile);
@@ -36,6 +36,12 @@
 #include <limits>
 #include <ctime>
 #include <memory>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
 
 #define DP2CUTOFF 6.25
 
@@ -90,6 +96,17 @@ Metadynamics can be restarted either from a HILLS file as well as from a GRID, i
 case one can first save a GRID using GRID_WFILE (and GRID_WSTRIDE) and at a later stage read
 it using GRID_RFILE.
 
+Restarting from a long HILLS file can be slow, since all the hills have to be summed again on the grid.
+Using GRID_CHECKPOINT (together with GRID_WSTRIDE) the grid is regularly saved in a compact binary file
+that also contains the number of hills that have been already summed. Upon RESTART, the grid is read
+from this file and only the hills deposited after the last checkpoint are read from the HILLS file.
+The binary file is meant to be read by PLUMED on the same architecture and does not depend on the
+number of MPI processes. It cannot be compressed, so names ending in .gz or .pbin are not accepted.
+Each checkpoint is first written on a temporary file, synced to disk and then renamed, so that
+a crash never leaves a truncated checkpoint. The HILLS file is only flushed before the checkpoint is
+written: if after a crash it contains less hills than the checkpoint, PLUMED stops with an error
+and the checkpoint should be removed to restart from the HILLS file alone.
+
 Another option that is available in plumed is well-tempered metadynamics \cite Barducci:2008. In this
 varient of metadynamics the heights of the Gaussian hills are rescaled at each step so the bias is now
 given by:
@@ -155,6 +172,11 @@ Additional material and examples can be also found in the tutorials:
 - \ref belfast-7
 - \ref belfast-8
 
+When grids are not used, hills are stored in a spatial index made of cells in CV space
+with a size comparable to the Gaussian support, so that at every step only the hills
+that are close enough to the current position are evaluated. Still, grids are
+considerably faster and should be used whenever possible.
+
 Notice that at variance with PLUMED 1.3 it is now straightforward to apply concurrent metadynamics
 as done e.g. in Ref. \cite gil2015enhanced . This indeed can be obtained by using the METAD
 action multiple times in the same input file.
@@ -363,8 +385,18 @@ private:
   vector<double> sigma0min_;
   vector<double> sigma0max_;
   vector<Gaussian> hills_;
+// spatial index of the hills, used when grids are not available
+  vector<double> hills_cellwidth_;
+  vector<long int> hills_ncells_;
+  vector<double> hills_maxwidth_;
+  std::map<vector<long int>,vector<unsigned> > hills_cells_;
+  vector<unsigned> hills_far_;
+  vector<unsigned> hills_close_;
   OFile hillsOfile_;
   OFile gridfile_;
+  string checkpointfilename_;
+  bool checkpointWriter_;
+  vector<uint64_t> nhills_;
   std::unique_ptr<Grid> BiasGrid_;
   bool storeOldGrids_;
   int wgridstride_;
@@ -413,7 +445,9 @@ private:
   static void   registerTemperingKeywords(const std::string &name_stem, const std::string &name, Keywords &keys);
   void   readTemperingSpecs(TemperingSpecs &t_specs);
   void   logTemperingSpecs(const TemperingSpecs &t_specs);
-  void   readGaussians(IFile*);
+  unsigned readGaussians(IFile*);
+  bool   readCheckpoint();
+  void   writeCheckpoint();
   void   writeGaussian(const Gaussian&,OFile&);
   void   addGaussian(const Gaussian&);
   double getHeight(const vector<double>&);
@@ -422,6 +456,10 @@ private:
   double evaluateGaussian(const vector<double>&, const Gaussian&,double* der=NULL);
   double getGaussianNormalization( const Gaussian& );
   vector<unsigned> getGaussianSupport(const Gaussian&);
+  vector<double> getGaussianHalfWidths(const Gaussian&);
+  long int getHillsCell(unsigned i,double x);
+  void   addHillToIndex(unsigned ihill);
+  void   getCloseHills(const vector<double>&,vector<unsigned>&);
   bool   scanOneHill(IFile *ifile,  vector<Value> &v, vector<double> &center, vector<double>  &sigma, double &height, bool &multivariate);
   void   computeReweightingFactor();
   double getTransitionBarrierBias();
@@ -431,6 +469,7 @@ public:
   explicit MetaD(const ActionOptions&);
   void calculate();
   void update();
+  bool isHistoryDependent()const {return true;}
   static void registerKeywords(Keywords& keys);
   bool checkNeedsGradients()const {if(adaptive_==FlexibleBin::geometry) {return true;} else {return false;}}
 };
@@ -476,6 +515,7 @@ void MetaD::registerKeywords(Keywords& keys) {
   keys.add("optional","GRID_WSTRIDE","write the grid to a file every N steps");
   keys.add("optional","GRID_WFILE","the file on which to write the grid");
   keys.add("optional","GRID_RFILE","a grid file from which the bias should be read at the initial step of the simulation");
+  keys.add("optional","GRID_CHECKPOINT","a binary file on which the grid is written every GRID_WSTRIDE steps and from which it is read upon restart");
   keys.addFlag("STORE_GRIDS",false,"store all the grid files the calculation generates. They will be deleted if this keyword is not present");
   keys.add("optional","ADAPTIVE","use a geometric (=GEOM) or diffusion (=DIFF) based hills width scheme. Sigma is one number that has distance units or timestep dimensions");
   keys.add("optional","WALKERS_ID", "walker id");
@@ -712,18 +752,22 @@ MetaD::MetaD(const ActionOptions& ao):
   string gridfilename_;
   parse("GRID_WFILE",gridfilename_);
   parseFlag("STORE_GRIDS",storeOldGrids_);
-  if(grid_ && gridfilename_.length()>0) {
+  parse("GRID_CHECKPOINT",checkpointfilename_);
+  if(grid_ && (gridfilename_.length()>0 || checkpointfilename_.length()>0)) {
     if(wgridstride_==0 ) error("frequency with which to output grid not specified use GRID_WSTRIDE");
   }
 
   if(grid_ && wgridstride_>0) {
-    if(gridfilename_.length()==0) error("grid filename not specified use GRID_WFILE");
+    if(gridfilename_.length()==0 && checkpointfilename_.length()==0) error("grid filename not specified use GRID_WFILE");
   }
   string gridreadfilename_;
   parse("GRID_RFILE",gridreadfilename_);
 
   if(!grid_&&gridfilename_.length()> 0) error("To write a grid you need first to define it!");
   if(!grid_&&gridreadfilename_.length()>0) error("To read a grid you need first to define it!");
+  if(!grid_&&checkpointfilename_.length()>0) error("To checkpoint a grid you need first to define it!");
+  if(Tools::extension(checkpointfilename_)=="gz" || FileBase::isBinaryPath(checkpointfilename_))
+    error("GRID_CHECKPOINT cannot be a compressed file, remove the .gz or .pbin extension");
 
   if(grid_) {
     parseVector("REWEIGHTING_NGRID",rewf_grid_);
@@ -855,7 +899,7 @@ MetaD::MetaD(const ActionOptions& ao):
     log.printf("\n");
     if(spline) {log.printf("  Grid uses spline interpolation\n");}
     if(sparsegrid) {log.printf("  Grid uses sparse grid\n");}
-    if(wgridstride_>0) {log.printf("  Grid is written on file %s with stride %d\n",gridfilename_.c_str(),wgridstride_);}
+    if(wgridstride_>0 && gridfilename_.length()>0) {log.printf("  Grid is written on file %s with stride %d\n",gridfilename_.c_str(),wgridstride_);}
   }
 
   if(mw_n_>1) {
@@ -1038,6 +1082,23 @@ MetaD::MetaD(const ActionOptions& ao):
     }
   }
 
+  // the checkpoint stores the number of hills read from each HILLS file
+  nhills_.assign(mw_n_,0);
+  bool restartedFromCheckpoint=false;
+  if(checkpointfilename_.length()>0) {
+    // each filesystem walker has its own checkpoint, walkers_mpi share it
+    if(mw_n_>1) {
+      stringstream out; out << mw_id_;
+      checkpointfilename_=FileBase::appendSuffix(checkpointfilename_,"."+out.str());
+    } else if(!walkers_mpi) checkpointfilename_=FileBase::appendSuffix(checkpointfilename_,plumed.getSuffix());
+    log.printf("  Grid checkpoint is written on file %s with stride %d\n",checkpointfilename_.c_str(),wgridstride_);
+    if(getRestart() && !restartedFromGrid) {
+      restartedFromCheckpoint=readCheckpoint();
+      if(restartedFromCheckpoint) log.printf("  Restarting from checkpoint %s\n",checkpointfilename_.c_str());
+      else log.printf("  Checkpoint %s could not be read, all hills will be read\n",checkpointfilename_.c_str());
+    }
+  }
+
   // creating vector of ifile* for hills reading
   // open all files at the beginning and read Gaussians if restarting
   for(int i=0; i<mw_n_; ++i) {
@@ -1066,8 +1127,13 @@ MetaD::MetaD(const ActionOptions& ao):
     if(ifile->FileExist(fname)) {
       ifile->open(fname);
       if(getRestart()&&!restartedFromGrid) {
+        // hills already included in the checkpoint are skipped without reading their values
+        if(restartedFromCheckpoint) {
+          uint64_t nskip=ifiles[i]->skipFields(nhills_[i]);
+          if(nskip<nhills_[i]) error("file "+ifilesnames[i]+" contains less hills than the checkpoint "+checkpointfilename_);
+        }
         log.printf("  Restarting from %s:",ifilesnames[i].c_str());
-        readGaussians(ifiles[i].get());
+        nhills_[i]+=readGaussians(ifiles[i].get());
       }
       ifiles[i]->reset(false);
       // close only the walker own hills file for later writing
@@ -1118,7 +1184,22 @@ MetaD::MetaD(const ActionOptions& ao):
       gridfile_.enforceSuffix("");
     }
     if(mw_n_>1) gridfile_.enforceSuffix("");
-    gridfile_.open(gridfilename_);
+    if(gridfilename_.length()>0) gridfile_.open(gridfilename_);
+  }
+
+  // the checkpoint is written only by the first process, and by the first replica with walkers_mpi
+  checkpointWriter_=false;
+  if(checkpointfilename_.length()>0) {
+    int r=0;
+    if(walkers_mpi && comm.Get_rank()==0) r=multi_sim_comm.Get_rank();
+    comm.Bcast(r,0);
+    checkpointWriter_=(comm.Get_rank()==0 && r==0);
+    // the checkpoint of a previous run is backed up as the other output files
+    if(checkpointWriter_ && !getRestart()) {
+      OFile backup;
+      backup.link(*this);
+      backup.backupFile("bck",checkpointfilename_);
+    }
   }
 
   // open hills file for writing
@@ -1213,7 +1294,7 @@ void MetaD::logTemperingSpecs(const TemperingSpecs &t_specs) {
   if (t_specs.alpha != 1.0) log.printf("  %s decay shape parameter alpha %f\n", t_specs.name.c_str(), t_specs.alpha);
 }
 
-void MetaD::readGaussians(IFile *ifile)
+unsigned MetaD::readGaussians(IFile *ifile)
 {
   unsigned ncv=getNumberOfArguments();
   vector<double> center(ncv);
@@ -1233,6 +1314,61 @@ void MetaD::readGaussians(IFile *ifile)
     addGaussian(Gaussian(center,sigma,height,multivariate));
   }
   log.printf("      %d Gaussians read\n",nhills);
+  return nhills;
+}
+
+// the checkpoint contains a header, the number of hills read from each HILLS file,
+// the c(t) reweighting factor, and finally the grid in binary format
+static const char metad_checkpoint_magic[]="PLUMED_METAD_CHECKPOINT_1";
+
+bool MetaD::readCheckpoint()
+{
+  std::ifstream is(checkpointfilename_.c_str(),std::ios::binary);
+  if(!is) return false;
+  char magic[sizeof(metad_checkpoint_magic)];
+  is.read(magic,sizeof(magic));
+  if(!is || std::string(magic,sizeof(magic))!=std::string(metad_checkpoint_magic,sizeof(magic))) return false;
+  uint64_t nfiles=0;
+  is.read(reinterpret_cast<char*>(&nfiles),sizeof(nfiles));
+  if(!is || nfiles!=nhills_.size()) return false;
+  vector<uint64_t> nhills(nfiles);
+  is.read(reinterpret_cast<char*>(&nhills[0]),nfiles*sizeof(uint64_t));
+  double rewf=0.0;
+  is.read(reinterpret_cast<char*>(&rewf),sizeof(rewf));
+  if(!is || !BiasGrid_->readBinary(is)) {
+    BiasGrid_->clear();
+    return false;
+  }
+  nhills_=nhills;
+  reweight_factor=rewf;
+  return true;
+}
+
+void MetaD::writeCheckpoint()
+{
+  // hills included in the checkpoint are passed to the operating system before it is written
+  hillsOfile_.flush();
+  hillsOfile_.sync();
+  if(!checkpointWriter_) return;
+  std::ostringstream os;
+  os.write(metad_checkpoint_magic,sizeof(metad_checkpoint_magic));
+  uint64_t nfiles=nhills_.size();
+  os.write(reinterpret_cast<const char*>(&nfiles),sizeof(nfiles));
+  os.write(reinterpret_cast<const char*>(&nhills_[0]),nfiles*sizeof(uint64_t));
+  os.write(reinterpret_cast<const char*>(&reweight_factor),sizeof(reweight_factor));
+  BiasGrid_->writeBinary(os);
+  // the checkpoint is synced to disk on a temporary file and then renamed,
+  // so that the previous checkpoint is replaced only by a complete one
+  const std::string & buffer(os.str());
+  const std::string tmpname=checkpointfilename_+".tmp";
+  FILE* fp=std::fopen(tmpname.c_str(),"wb");
+  if(!fp) error("cannot open file "+tmpname+" for writing the checkpoint");
+  bool ok=std::fwrite(buffer.c_str(),1,buffer.size(),fp)==buffer.size();
+  ok=(std::fflush(fp)==0) && ok;
+  ok=(fsync(fileno(fp))==0) && ok;
+  ok=(std::fclose(fp)==0) && ok;
+  if(!ok) error("cannot write the checkpoint on file "+tmpname);
+  if(std::rename(tmpname.c_str(),checkpointfilename_.c_str())!=0) error("cannot rename "+tmpname+" into "+checkpointfilename_);
 }
 
 void MetaD::writeGaussian(const Gaussian& hill, OFile&file)
@@ -1288,8 +1424,10 @@ void MetaD::writeGaussian(const Gaussian& hill, OFile&file)
 
 void MetaD::addGaussian(const Gaussian& hill)
 {
-  if(!grid_) hills_.push_back(hill);
-  else {
+  if(!grid_) {
+    hills_.push_back(hill);
+    addHillToIndex(hills_.size()-1);
+  } else {
     unsigned ncv=getNumberOfArguments();
     vector<unsigned> nneighb=getGaussianSupport(hill);
     vector<Grid::index_t> neighbors=BiasGrid_->getNeighbors(hill.center,nneighb);
@@ -1378,6 +1516,115 @@ vector<unsigned> MetaD::getGaussianSupport(const Gaussian& hill)
   return nneigh;
 }
 
+vector<double> MetaD::getGaussianHalfWidths(const Gaussian& hill)
+{
+  unsigned ncv=getNumberOfArguments();
+  vector<double> halfwidth(ncv);
+  if(hill.multivariate) {
+    unsigned k=0;
+    Matrix<double> mymatrix(ncv,ncv);
+    for(unsigned i=0; i<ncv; i++) {
+      for(unsigned j=i; j<ncv; j++) {
+        mymatrix(i,j)=mymatrix(j,i)=hill.sigma[k];
+        k++;
+      }
+    }
+    // the bounding box of the ellipsoid is given by the diagonal of the covariance
+    Matrix<double> myinv(ncv,ncv);
+    Invert(mymatrix,myinv);
+    for(unsigned i=0; i<ncv; i++) halfwidth[i]=sqrt(2.0*DP2CUTOFF*abs(myinv(i,i)));
+  } else {
+    for(unsigned i=0; i<ncv; i++) halfwidth[i]=sqrt(2.0*DP2CUTOFF)*abs(hill.sigma[i]);
+  }
+  return halfwidth;
+}
+
+long int MetaD::getHillsCell(unsigned i,double x)
+{
+  if(hills_ncells_[i]>0) {
+    double min,max;
+    getPntrToArgument(i)->getDomain(min,max);
+    long int cell=static_cast<long int>(floor((x-min)/hills_cellwidth_[i]))%hills_ncells_[i];
+    if(cell<0) cell+=hills_ncells_[i];
+    return cell;
+  }
+  return static_cast<long int>(floor(x/hills_cellwidth_[i]));
+}
+
+void MetaD::addHillToIndex(unsigned ihill)
+{
+  unsigned ncv=getNumberOfArguments();
+  vector<double> halfwidth=getGaussianHalfWidths(hills_[ihill]);
+  bool finite=true;
+  for(unsigned i=0; i<ncv; i++) if(!(halfwidth[i]>0.0) || halfwidth[i]>std::numeric_limits<double>::max()) finite=false;
+  // hills with an unbounded support are evaluated at every step
+  if(!finite) {
+    hills_far_.push_back(ihill);
+    return;
+  }
+  // the size of the cells is taken from the first hill
+  if(hills_cellwidth_.empty()) {
+    hills_cellwidth_=halfwidth;
+    hills_ncells_.assign(ncv,0);
+    hills_maxwidth_.assign(ncv,0.0);
+    for(unsigned i=0; i<ncv; i++) {
+      if(!getPntrToArgument(i)->isPeriodic()) continue;
+      double min,max;
+      getPntrToArgument(i)->getDomain(min,max);
+      hills_ncells_[i]=static_cast<long int>(floor((max-min)/halfwidth[i]));
+      if(hills_ncells_[i]<1) hills_ncells_[i]=1;
+      hills_cellwidth_[i]=(max-min)/hills_ncells_[i];
+    }
+  }
+  vector<long int> cell(ncv);
+  for(unsigned i=0; i<ncv; i++) {
+    cell[i]=getHillsCell(i,hills_[ihill].center[i]);
+    if(halfwidth[i]>hills_maxwidth_[i]) hills_maxwidth_[i]=halfwidth[i];
+  }
+  hills_cells_[cell].push_back(ihill);
+}
+
+void MetaD::getCloseHills(const vector<double>& cv,vector<unsigned>& close)
+{
+  close=hills_far_;
+  if(hills_cellwidth_.empty()) return;
+  unsigned ncv=getNumberOfArguments();
+  // range of cells to be searched in each direction
+  vector<long int> first(ncv),ncells(ncv);
+  double ntot=1.0;
+  for(unsigned i=0; i<ncv; i++) {
+    long int m=static_cast<long int>(ceil(hills_maxwidth_[i]/hills_cellwidth_[i]));
+    if(hills_ncells_[i]>0 && 2*m+1>=hills_ncells_[i]) {
+      first[i]=0; ncells[i]=hills_ncells_[i];
+    } else {
+      first[i]=getHillsCell(i,cv[i])-m; ncells[i]=2*m+1;
+    }
+    ntot*=ncells[i];
+  }
+  if(ntot>hills_cells_.size()) {
+    // cheaper to loop over all the occupied cells
+    for(const auto & c : hills_cells_) close.insert(close.end(),c.second.begin(),c.second.end());
+  } else {
+    vector<long int> shift(ncv,0),cell(ncv);
+    while(true) {
+      for(unsigned i=0; i<ncv; i++) {
+        cell[i]=first[i]+shift[i];
+        if(hills_ncells_[i]>0) cell[i]=(cell[i]%hills_ncells_[i]+hills_ncells_[i])%hills_ncells_[i];
+      }
+      auto c=hills_cells_.find(cell);
+      if(c!=hills_cells_.end()) close.insert(close.end(),c->second.begin(),c->second.end());
+      unsigned i=0;
+      for(; i<ncv; i++) {
+        if(++shift[i]<ncells[i]) break;
+        shift[i]=0;
+      }
+      if(i==ncv) break;
+    }
+  }
+  // hills are evaluated in the order in which they were added
+  std::sort(close.begin(),close.end());
+}
+
 double MetaD::getBiasAndDerivatives(const vector<double>& cv, double* der)
 {
   double bias=0.0;
@@ -1389,21 +1636,22 @@ double MetaD::getBiasAndDerivatives(const vector<double>& cv, double* der)
       warning(msg);
       last_step_warn_grid=getStep();
     }
+    // with INTERVAL the hills are evaluated at the boundary
+    if(doInt_) {
+      vector<double> xx(cv);
+      if(xx[0]<lowI_) xx[0]=lowI_;
+      if(xx[0]>uppI_) xx[0]=uppI_;
+      getCloseHills(xx,hills_close_);
+    } else getCloseHills(cv,hills_close_);
     unsigned stride=comm.Get_size();
     unsigned rank=comm.Get_rank();
-    for(unsigned i=rank; i<hills_.size(); i+=stride) {
-      bias+=evaluateGaussian(cv,hills_[i],der);
+    for(unsigned i=rank; i<hills_close_.size(); i+=stride) {
+      bias+=evaluateGaussian(cv,hills_[hills_close_[i]],der);
     }
     comm.Sum(bias);
     if(der) comm.Sum(der,getNumberOfArguments());
   } else {
-    if(der) {
-      vector<double> vder(getNumberOfArguments());
-      bias=BiasGrid_->getValueAndDerivatives(cv,vder);
-      for(unsigned i=0; i<getNumberOfArguments(); ++i) {der[i]=vder[i];}
-    } else {
-      bias = BiasGrid_->getValue(cv);
-    }
+    BiasGrid_->getValuesAndDerivatives(1,&cv[0],&bias,der);
   }
 
   return bias;
@@ -1644,12 +1892,14 @@ void MetaD::update() {
         Gaussian newhill=Gaussian(cv_now,sigma_now,all_height[i]*(biasf_>1.0?(biasf_-1.0)/biasf_:1.0),all_multivariate[i]);
         addGaussian(newhill);
         writeGaussian(newhill,hillsOfile_);
+        nhills_[mw_id_]++;
       }
     } else {
       Gaussian newhill=Gaussian(cv,thissigma,height,multivariate);
       addGaussian(newhill);
       // print on HILLS file
       writeGaussian(newhill,hillsOfile_);
+      nhills_[mw_id_]++;
     }
   }
 
@@ -1663,7 +1913,7 @@ void MetaD::update() {
   work_+=vbias1-vbias;
 
   // dump grid on file
-  if(wgridstride_>0&&(getStep()%wgridstride_==0||getCPT())) {
+  if(wgridstride_>0&&gridfile_.isOpen()&&(getStep()%wgridstride_==0||getCPT())) {
     // in case old grids are stored, a sequence of grids should appear
     // this call results in a repetition of the header:
     if(storeOldGrids_) gridfile_.clearFields();
@@ -1702,7 +1952,7 @@ void MetaD::update() {
         // otherwise read the new Gaussians
       } else {
         log.printf("  Reading hills from %s:",ifilesnames[i].c_str());
-        readGaussians(ifiles[i].get());
+        nhills_[i]+=readGaussians(ifiles[i].get());
         ifiles[i]->reset(false);
       }
     }
@@ -1718,6 +1968,8 @@ void MetaD::update() {
     transition_bias_ = getTransitionBarrierBias();
     getPntrToComponent("transbias")->set(transition_bias_);
   }
+  // the checkpoint is written when the grid contains all the hills read so far
+  if(checkpointfilename_.length()>0 && (getStep()%wgridstride_==0||getCPT())) writeCheckpoint();
 }
 
 /// takes a pointer to the file and a template string with values v and gives back the next center, sigma and height
@@ -1819,17 +2071,29 @@ void MetaD::computeReweightingFactor()
   double sum1=0.0; double sum2=0.0;
   double afactor = biasf_ / (kbt_*(biasf_-1.0)); double afactor2 = 1.0 / (kbt_*(biasf_-1.0));
   unsigned rank=comm.Get_rank(), stride=comm.Get_size();
-  for(unsigned i=rank; i<ntotgrid; i+=stride) {
-    t_index[0]=(i%rewf_grid_[0]);
-    unsigned kk=i;
-    for(unsigned j=1; j<ncv-1; ++j) { kk=(kk-t_index[j-1])/rewf_grid_[i-1]; t_index[j]=(kk%rewf_grid_[i]); }
-    if( ncv>=2 ) t_index[ncv-1]=((kk-t_index[ncv-1])/rewf_grid_[ncv-2]);
-
-    for(unsigned j=0; j<ncv; ++j) vals[j]=dmin[j] + t_index[j]*grid_spacing[j];
+  // points are processed in blocks, so that the bias grid is interpolated on a whole block at once
+  const unsigned nblock=256;
+  std::vector<double> xblock( nblock*ncv ), bblock( nblock );
+  for(unsigned i0=rank; i0<ntotgrid; i0+=nblock*stride) {
+    unsigned n=0;
+    for(unsigned i=i0; i<ntotgrid && n<nblock; i+=stride, ++n) {
+      t_index[0]=(i%rewf_grid_[0]);
+      unsigned kk=i;
+      for(unsigned j=1; j<ncv-1; ++j) { kk=(kk-t_index[j-1])/rewf_grid_[i-1]; t_index[j]=(kk%rewf_grid_[i]); }
+      if( ncv>=2 ) t_index[ncv-1]=((kk-t_index[ncv-1])/rewf_grid_[ncv-2]);
+
+      for(unsigned j=0; j<ncv; ++j) xblock[n*ncv+j]=dmin[j] + t_index[j]*grid_spacing[j];
+    }
 
-    double currentb=getBiasAndDerivatives(vals,der.get());
-    sum1 += exp( afactor*currentb );
-    sum2 += exp( afactor2*currentb );
+    if(grid_) BiasGrid_->getValuesAndDerivatives(n,&xblock[0],&bblock[0],NULL);
+    else for(unsigned k=0; k<n; ++k) {
+        vals.assign(&xblock[k*ncv],&xblock[k*ncv]+ncv);
+        bblock[k]=getBiasAndDerivatives(vals,der.get());
+      }
+    for(unsigned k=0; k<n; ++k) {
+      sum1 += exp( afactor*bblock[k] );
+      sum2 += exp( afactor2*bblock[k] );
+    }
   }
   comm.Sum( sum1 ); comm.Sum( sum2 );
   reweight_factor = kbt_ * std::log( sum1/sum2 );
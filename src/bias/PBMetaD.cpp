@@ -280,6 +280,7 @@ public:
   explicit PBMetaD(const ActionOptions&);
   void calculate();
   void update();
+  bool isHistoryDependent()const {return true;}
   static void registerKeywords(Keywords& keys);
   bool checkNeedsGradients()const {if(adaptive_==FlexibleBin::geometry) {return true;} else {return false;}}
 };
@@ -889,13 +890,7 @@ double PBMetaD::getBiasAndDerivatives(unsigned iarg, const vector<double>& cv, d
     comm.Sum(bias);
     if(der) comm.Sum(der,1);
   } else {
-    if(der) {
-      vector<double> vder(1);
-      bias = BiasGrids_[iarg]->getValueAndDerivatives(cv,vder);
-      der[0] = vder[0];
-    } else {
-      bias = BiasGrids_[iarg]->getValue(cv);
-    }
+    BiasGrids_[iarg]->getValuesAndDerivatives(1,&cv[0],&bias,der);
   }
 
   return bias;
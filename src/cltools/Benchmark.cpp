@@ -0,0 +1,295 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2018 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "CLTool.h"
+#include "CLToolRegister.h"
+#include "core/PlumedMain.h"
+#include "tools/Communicator.h"
+#include "tools/File.h"
+#include "tools/OpenMP.h"
+#include "tools/Profiler.h"
+#include "tools/Random.h"
+#include "tools/Tools.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace PLMD {
+namespace cltools {
+
+//+PLUMEDOC TOOLS benchmark
+/*
+benchmark measures the cost per step of a plumed input on a synthetic system.
+
+A system made of randomly placed atoms in a cubic box is generated, and PLUMED
+is driven through the same sequence of calls used by MD codes for the requested number of steps.
+At every step, atoms are displaced randomly by at most the amount
+specified with --displacement, so that e.g. neighbor lists are updated. Atoms
+are numbered from 1 to --natoms and can thus be used in the plumed input file.
+
+The time per step (in nanoseconds) is reported for each phase of the calculation
+(preparing dependencies, sharing atoms, waiting for them, forward loop, backward loop and update) and for each action
+(summing calculate, apply and update). The first --nwarmup steps are not included.
+When running with MPI, atoms are split among processes with a particle decomposition
+and the reported timings are the maximum over processes.
+
+With --nthreads a comma separated list of numbers of OpenMP threads can be given,
+and the benchmark is repeated for each of them.
+Results can be saved on a file with --save and later compared with the current run using --baseline.
+In this case, the ratio between the current and the baseline timings is reported,
+and the tool returns a non-zero exit code if any phase or action is slower than
+the baseline by more than the fraction given with --tolerance.
+
+\par Examples
+
+The following command measures the cost of plumed.dat on a system of 10000 atoms,
+using one, two and four threads, and saves the results:
+\verbatim
+plumed benchmark --plumed plumed.dat --natoms 10000 --nsteps 500 --nthreads 1,2,4 --save baseline.dat
+\endverbatim
+
+The same command can be later used to check for regressions:
+\verbatim
+plumed benchmark --plumed plumed.dat --natoms 10000 --nsteps 500 --nthreads 1,2,4 --baseline baseline.dat
+\endverbatim
+
+*/
+//+ENDPLUMEDOC
+
+class Benchmark:
+  public CLTool
+{
+public:
+  static void registerKeywords( Keywords& keys );
+  explicit Benchmark(const CLToolOptions& co );
+  int main(FILE* in, FILE*out,Communicator& pc);
+  string description()const {
+    return "measure the cost per step of a plumed input";
+  }
+};
+
+PLUMED_REGISTER_CLTOOL(Benchmark,"benchmark")
+
+void Benchmark::registerKeywords( Keywords& keys ) {
+  CLTool::registerKeywords( keys );
+  keys.add("compulsory","--plumed","plumed.dat","specify the name of the plumed input file");
+  keys.add("compulsory","--natoms","1000","the number of atoms in the synthetic system");
+  keys.add("compulsory","--density","100","the number of atoms per cubic nanometer, used to set the size of the box");
+  keys.add("compulsory","--displacement","0.01","the maximum displacement of each atom at every step, in nanometers");
+  keys.add("compulsory","--nsteps","100","the number of steps that are timed");
+  keys.add("compulsory","--nwarmup","10","the number of steps done before timing");
+  keys.add("compulsory","--nthreads","1","comma separated list of numbers of OpenMP threads to be used");
+  keys.add("compulsory","--timestep","0.002","the timestep in picoseconds");
+  keys.add("compulsory","--seed","1","the seed for the random number generator");
+  keys.add("compulsory","--log","benchmark.log","the file where the plumed log is written");
+  keys.add("compulsory","--tolerance","0.1","the maximum allowed relative slowdown with respect to the baseline");
+  keys.add("optional","--kt","set kBT, it will not be necessary to specify temperature in input file");
+  keys.add("optional","--save","save the timings on this file");
+  keys.add("optional","--baseline","compare the timings with those saved on this file");
+}
+
+Benchmark::Benchmark(const CLToolOptions& co ):
+  CLTool(co)
+{
+  inputdata=commandline;
+}
+
+int Benchmark::main(FILE* in, FILE*out,Communicator& pc) {
+  string plumedFile; parse("--plumed",plumedFile);
+  int natoms; parse("--natoms",natoms);
+  double density; parse("--density",density);
+  double displacement; parse("--displacement",displacement);
+  int nsteps; parse("--nsteps",nsteps);
+  int nwarmup; parse("--nwarmup",nwarmup);
+  vector<unsigned> nthreads; parseVector("--nthreads",nthreads);
+  double timestep; parse("--timestep",timestep);
+  int seed; parse("--seed",seed);
+  string logFile; parse("--log",logFile);
+  double tolerance; parse("--tolerance",tolerance);
+  double kt=-1.0; parse("--kt",kt);
+  string saveFile; parse("--save",saveFile);
+  string baselineFile; parse("--baseline",baselineFile);
+  if(natoms<=0) error("--natoms should be positive");
+  if(nsteps<=0) error("--nsteps should be positive");
+  if(nthreads.size()==0) error("--nthreads should contain at least one number");
+
+  const double side=std::cbrt(natoms/density);
+  const unsigned nranks=pc.Get_size();
+  const unsigned rank=pc.Get_rank();
+// particle decomposition
+  int nlocal=natoms/nranks;
+  int start=rank*nlocal;
+  if(rank<natoms%nranks) {nlocal++; start+=rank;}
+  else start+=natoms%nranks;
+
+// only the root process writes the log
+  FILE* log=std::fopen((rank==0?logFile.c_str():"/dev/null"),"w");
+  if(!log) error("cannot open log file "+logFile);
+
+  static const unsigned nphases=6;
+  static const char* phases[nphases]= {"1_prepare_dependencies","2_sharing_data","3_waiting_for_data",
+                                       "4_calculating","5_applying","6_update"
+                                      };
+
+// timings in ns/step, labelled by number of threads and name
+  vector<pair<pair<unsigned,string>,double> > results;
+
+  for(const auto nt : nthreads) {
+    OpenMP::setNumThreads(nt);
+    Random random;
+    random.setSeed(-seed);
+    vector<double> positions(3*natoms),forces(3*natoms,0.0),masses(natoms,1.0),charges(natoms,0.0);
+    vector<double> box(9,0.0),virial(9,0.0);
+    box[0]=box[4]=box[8]=side;
+    for(auto & p : positions) p=side*random.RandU01();
+
+    PlumedMain p;
+    int rr=sizeof(double);
+    p.cmd("setRealPrecision",&rr);
+    if(Communicator::initialized()) p.cmd("setMPIComm",&pc.Get_comm());
+    p.cmd("setMDEngine","benchmark");
+    p.cmd("setTimestep",&timestep);
+    p.cmd("setPlumedDat",plumedFile.c_str());
+    p.cmd("setLog",log);
+    p.cmd("setNatoms",&natoms);
+    if(kt>=0.0) p.cmd("setKbT",&kt);
+    p.cmd("init");
+    if(nranks>1) {
+      p.cmd("setAtomsNlocal",&nlocal);
+      p.cmd("setAtomsContiguous",&start);
+    }
+
+    vector<long long int> phaseTimes(nphases,0);
+    for(long int step=0; step<nwarmup+nsteps; step++) {
+      if(step==nwarmup) p.enableProfiler();
+      for(auto & x : positions) x+=displacement*(2.0*random.RandU01()-1.0);
+      for(auto & f : forces) f=0.0;
+      for(auto & v : virial) v=0.0;
+      p.cmd("setStepLong",&step);
+      p.cmd("setPositions",&positions[3*start]);
+      p.cmd("setForces",&forces[3*start]);
+      p.cmd("setMasses",&masses[start]);
+      p.cmd("setCharges",&charges[start]);
+      p.cmd("setBox",&box[0]);
+      p.cmd("setVirial",&virial[0]);
+// same sequence as cmd("calc"), with each phase timed separately
+      std::chrono::time_point<std::chrono::high_resolution_clock> t[nphases+1];
+      t[0]=std::chrono::high_resolution_clock::now();
+      p.prepareDependencies();
+      t[1]=std::chrono::high_resolution_clock::now();
+      p.shareData();
+      t[2]=std::chrono::high_resolution_clock::now();
+      p.waitData();
+      t[3]=std::chrono::high_resolution_clock::now();
+      p.justCalculate();
+      t[4]=std::chrono::high_resolution_clock::now();
+      p.backwardPropagate();
+      t[5]=std::chrono::high_resolution_clock::now();
+      p.update();
+      t[6]=std::chrono::high_resolution_clock::now();
+      if(step>=nwarmup) for(unsigned i=0; i<nphases; i++)
+          phaseTimes[i]+=std::chrono::duration_cast<std::chrono::nanoseconds>(t[i+1]-t[i]).count();
+    }
+
+    vector<double> times(nphases);
+    for(unsigned i=0; i<nphases; i++) times[i]=double(phaseTimes[i])/nsteps;
+    const Profiler & profiler(p.enableProfiler());
+    vector<string> labels;
+    for(unsigned i=0; i<profiler.getNumberOfTasks(); i++) {
+      double t=0.0;
+      for(unsigned j=0; j<Profiler::nphases; j++) t+=profiler.getTotal(Profiler::Phase(j),i);
+      if(profiler.getCycles(Profiler::calculate,i)+profiler.getCycles(Profiler::apply,i)+profiler.getCycles(Profiler::update,i)==0) continue;
+      times.push_back(t/nsteps);
+      labels.push_back(profiler.getLabel(i));
+    }
+// slowest process
+    if(nranks>1) {
+      vector<double> all(nranks*times.size());
+      pc.Allgather(times,all);
+      for(unsigned r=0; r<nranks; r++) for(unsigned i=0; i<times.size(); i++)
+          if(all[r*times.size()+i]>times[i]) times[i]=all[r*times.size()+i];
+    }
+
+    double total=0.0;
+    for(unsigned i=0; i<nphases; i++) total+=times[i];
+    fprintf(out,"BENCHMARK: %d atoms, %u processes, %u threads, %d steps\n",natoms,nranks,nt,nsteps);
+    fprintf(out,"BENCHMARK: %-40s %14.1f ns/step\n","total",total);
+    results.push_back(make_pair(make_pair(nt,string("total")),total));
+    for(unsigned i=0; i<nphases; i++) {
+      fprintf(out,"BENCHMARK: %-40s %14.1f ns/step\n",phases[i],times[i]);
+      results.push_back(make_pair(make_pair(nt,string(phases[i])),times[i]));
+    }
+    for(unsigned i=0; i<labels.size(); i++) {
+      fprintf(out,"BENCHMARK: %-40s %14.1f ns/step\n",("action_"+labels[i]).c_str(),times[nphases+i]);
+      results.push_back(make_pair(make_pair(nt,"action_"+labels[i]),times[nphases+i]));
+    }
+  }
+  OpenMP::setNumThreads(0);
+  std::fclose(log);
+
+  if(saveFile.length()>0) {
+    OFile ofile;
+    ofile.link(pc);
+    ofile.open(saveFile);
+    for(const auto & r : results) {
+      ofile.printField("threads",int(r.first.first));
+      ofile.printField("name"," "+r.first.second);
+      ofile.printField("ns_per_step",r.second);
+      ofile.printField();
+    }
+  }
+
+  int ret=0;
+  if(baselineFile.length()>0) {
+    map<pair<unsigned,string>,double> baseline;
+    IFile ifile;
+    ifile.link(pc);
+    ifile.open(baselineFile);
+    int nt;
+    while(ifile.scanField("threads",nt)) {
+      string name;
+      double t;
+      ifile.scanField("name",name);
+      ifile.scanField("ns_per_step",t);
+      ifile.scanField();
+      baseline[make_pair(unsigned(nt),name)]=t;
+    }
+    for(const auto & r : results) {
+      const auto b=baseline.find(r.first);
+      if(b==baseline.end()) continue;
+      double ratio=r.second/b->second;
+      bool slower=(ratio>1.0+tolerance);
+      fprintf(out,"BASELINE: %u threads %-40s %14.1f ns/step (baseline %14.1f) ratio %6.3f%s\n",
+              r.first.first,r.first.second.c_str(),r.second,b->second,ratio,(slower?" SLOWER":""));
+      if(slower) ret=1;
+    }
+  }
+  return ret;
+}
+
+}
+}
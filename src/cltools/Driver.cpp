@@ -28,13 +28,19 @@
 #include "tools/Pbc.h"
 #include <cstdio>
 #include <cstring>
+#include <cstdint>
 #include <vector>
 #include <map>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 #include "tools/Units.h"
 #include "tools/PDB.h"
 #include "tools/FileBase.h"
 #include "tools/IFile.h"
+#include "tools/MappedFile.h"
 
 // when using molfile plugin
 #ifdef __PLUMED_HAS_MOLFILE_PLUGINS
@@ -166,6 +172,37 @@ plumed driver --plumed plumed.dat --imf_crd trajectory.crd --natoms 128
 
 Check the available molfile plugins and limitations at [this link](http://www.ks.uiuc.edu/Research/vmd/plugins/molfile/).
 
+When decoding the trajectory is expensive (e.g. for large xtc files), frames can be read in advance
+by a separate thread while PLUMED is analyzing the current one. The `--prefetch` option sets
+how many frames are kept ready in memory:
+\verbatim
+plumed driver --plumed plumed.dat --pdb diala.pdb --mf_xtc traj.xtc --prefetch 4
+\endverbatim
+
+Trajectories in dcd (`--idcd`), trr (`--itrr-mmap`) and in the raw binary format
+written by \ref DUMPATOMS (`--iraw`) are instead read by mapping the file in memory.
+Since all frames in these formats have the same size, each of them can be located directly
+in the file, without reading the previous ones. Raw files written with the same precision used by the driver
+are not even copied: PLUMED reads the positions directly from the mapped file.
+\verbatim
+plumed driver --plumed plumed.dat --pdb diala.pdb --idcd traj.dcd
+\endverbatim
+These readers only support dcd files without fixed atoms and trr files where all the frames contain the same data
+(e.g. positions and cell). Files with a different content can be read with the corresponding molfile plugin.
+
+When PLUMED is compiled with MPI, a long trajectory can also be analyzed by several processes at the same
+time with the `--parallel-frames` flag. The trajectory is split in contiguous chunks of frames,
+each of them analyzed by a different process. Output files (including the one written with `--dump-forces`)
+are written by each process with a different suffix and, at the end of the calculation,
+they are appended in time order to the ones written by the first process:
+\verbatim
+mpirun -np 8 plumed driver --plumed plumed.dat --pdb diala.pdb --mf_xtc traj.xtc --parallel-frames
+\endverbatim
+Notice that each process only sees the frames of its own chunk. This is thus only possible for inputs
+that analyze each frame independently (e.g. \ref PRINT or \ref DUMPATOMS). Time dependent biases (e.g. \ref METAD)
+and actions accumulating data along the trajectory (e.g. \ref HISTOGRAM), whose results would be computed
+separately for each chunk, stop the calculation with an error. Binary xtc, trr and raw output files are not merged.
+
 Additionally, you can use the xdrfile implementation of xtc and trr. To this aim, just
 download and install properly the xdrfile library (see [this link](http://www.gromacs.org/Developer_Zone/Programming_Guide/XTC_Library)).
 If the xdrfile library is installed properly the PLUMED configure script should be able to
@@ -195,8 +232,119 @@ static int register_cb(void *v, vmdplugin_t *p) {
 }
 #endif
 
+/// Read a number of type T stored at p, reversing the order of its bytes if swap is true
+template<typename T>
+static T readBinary(const char* p,bool swap) {
+  char b[sizeof(T)];
+  if(swap) for(unsigned i=0; i<sizeof(T); i++) b[i]=p[sizeof(T)-1-i];
+  else std::memcpy(b,p,sizeof(T));
+  T t;
+  std::memcpy(&t,b,sizeof(T));
+  return t;
+}
+
 template<typename real>
 class Driver : public CLTool {
+/// A frame read from the trajectory
+  struct Frame {
+    int natoms=0;
+/// Is the step number read from the trajectory
+    bool has_step=false;
+    long int step=0;
+    std::vector<real> coordinates;
+    std::vector<real> cell;
+/// If not NULL, positions are taken from here rather than from coordinates.
+/// Used to pass to plumed the positions stored in a mapped trajectory file
+    const real* positions=NULL;
+  };
+/// Reads the frames of a trajectory in one of the supported formats
+  class TrajectoryReader {
+    Driver& driver;
+    std::string fmt;
+    FILE* fp=NULL;
+    bool close_fp=false;
+    bool pbc_cli_given;
+    std::vector<double> pbc_cli_box;
+    int natoms=0;
+    std::string line;
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+    molfile_plugin_t *api=NULL;
+    void *h_in=NULL;
+    molfile_timestep_t ts_in; // this is the structure that has the timestep
+    std::unique_ptr<float[]> ts_in_coords;
+#endif
+#ifdef __PLUMED_HAS_XDRFILE
+    XDRFILE* xd=NULL;
+    std::unique_ptr<rvec[]> pos;
+#endif
+/// Trajectory mapped in memory, for the formats with frames of fixed size (dcd, trr and raw)
+    MappedFile mapped;
+/// Offset of the first frame and size of each frame in the mapped file
+    std::size_t mapped_first=0, mapped_frame_size=0;
+/// Number of frames in the mapped file and index of the next frame to be read
+    unsigned long mapped_nframes=0, mapped_next=0;
+/// Are numbers stored with the opposite endianness
+    bool mapped_swap=false;
+/// Size of real numbers in trr and raw files
+    unsigned mapped_precision=0;
+/// Size of the block containing the cell in dcd files, zero if absent
+    std::size_t dcd_cell_block=0;
+/// Number of coordinates per atom in dcd files
+    unsigned dcd_ndim=3;
+/// Integers stored in the header of the first trr frame (sizes of the sections, number of atoms, step and number of energies)
+    int32_t trr_header[13];
+/// Read an integer from the mapped file, checking that it is within the file
+    int32_t mappedInt(std::size_t offset)const;
+/// Read a real number with size mapped_precision from the mapped file
+    real mappedReal(std::size_t offset)const;
+/// Parse the header of the trr frame starting at offset, returns the offset of its data
+    std::size_t trrHeader(std::size_t offset,int32_t* header)const;
+    bool openMapped(const std::string& file);
+    void readMapped(Frame& frame);
+/// Build the cell from the lengths of the lattice vectors (in A) and the angles between them (in degrees)
+    static void cellFromDimensions(float A,float B,float C,float alpha,float beta,float gamma,std::vector<real>& cell);
+  public:
+    TrajectoryReader(Driver& driver,const std::string& fmt,bool pbc_cli_given,const std::vector<double>& pbc_cli_box);
+    ~TrajectoryReader();
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+/// Set the molfile plugin used to read the trajectory
+    void setMolfilePlugin(molfile_plugin_t* api) {this->api=api;}
+#endif
+/// Read from an already opened file
+    void setFile(FILE* fp) {this->fp=fp; close_fp=false;}
+/// Open the trajectory file, returns false in case of error
+    bool open(const std::string& file,int command_line_natoms);
+/// Read the next frame, returns false at the end of the trajectory
+    bool read(Frame& frame);
+/// Skip the next frame without decoding the coordinates, returns false at the end of the trajectory
+    bool skip();
+/// Check if frames can be accessed in any order with seek()
+    bool hasRandomAccess()const {return mapped.isOpen();}
+/// Number of frames in the trajectory, only available with random access
+    unsigned long getNumberOfFrames()const {return mapped_nframes;}
+/// Move to a frame, so that it is the next one to be read. Only available with random access
+    void seek(unsigned long frame);
+  };
+/// Reads the frames of a trajectory in advance in a separate thread, storing them in a ring buffer
+  class FramePrefetcher {
+    TrajectoryReader& reader;
+    std::vector<Frame> frames;
+/// First frame in the buffer and number of frames that are ready
+    unsigned first=0, nready=0;
+/// Is the frame at first being used by the caller
+    bool inuse=false;
+    bool eof=false, stop=false;
+    std::exception_ptr exception;
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::thread reader_thread;
+    void run();
+  public:
+    FramePrefetcher(TrajectoryReader& reader,unsigned nframes);
+    ~FramePrefetcher();
+/// Get the next frame, which stays valid until the following call. Returns NULL at the end of the trajectory
+    Frame* next();
+  };
 public:
   static void registerKeywords( Keywords& keys );
   explicit Driver(const CLToolOptions& co );
@@ -220,6 +368,9 @@ void Driver<real>::registerKeywords( Keywords& keys ) {
 #endif
           );
   keys.add("compulsory","--multi","0","set number of replicas for multi environment (needs mpi)");
+  keys.addFlag("--parallel-frames",false,"split the trajectory in contiguous chunks that are analyzed independently by the MPI processes, "
+               "and merge the output files in time order at the end (needs mpi)");
+  keys.add("compulsory","--prefetch","0","number of frames that are read in advance by a separate thread while plumed analyzes the current one (0 means that frames are read when needed)");
   keys.addFlag("--noatoms",false,"don't read in a trajectory.  Just use colvar files as specified in plumed.dat");
   keys.add("atoms","--ixyz","the trajectory in xyz format");
   keys.add("atoms","--igro","the trajectory in gro format");
@@ -227,6 +378,9 @@ void Driver<real>::registerKeywords( Keywords& keys ) {
   keys.add("atoms","--ixtc","the trajectory in xtc format (xdrfile implementation)");
   keys.add("atoms","--itrr","the trajectory in trr format (xdrfile implementation)");
 #endif
+  keys.add("atoms","--idcd","the trajectory in dcd format (memory mapped implementation)");
+  keys.add("atoms","--itrr-mmap","the trajectory in trr format (memory mapped implementation, all frames should contain the same data)");
+  keys.add("atoms","--iraw","the trajectory in the raw binary format written by DUMPATOMS (memory mapped implementation)");
   keys.add("optional","--length-units","units for length, either as a string or a number");
   keys.add("optional","--mass-units","units for mass in pdb and mc file, either as a string or a number");
   keys.add("optional","--charge-units","units for charge in pdb and mc file, either as a string or a number");
@@ -266,6 +420,479 @@ Driver<real>::Driver(const CLToolOptions& co ):
 template<typename real>
 string Driver<real>::description()const { return "analyze trajectories with plumed"; }
 
+template<typename real>
+Driver<real>::TrajectoryReader::TrajectoryReader(Driver& driver,const std::string& fmt,bool pbc_cli_given,const std::vector<double>& pbc_cli_box):
+  driver(driver),
+  fmt(fmt),
+  pbc_cli_given(pbc_cli_given),
+  pbc_cli_box(pbc_cli_box)
+{
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  ts_in.coords=NULL;
+  ts_in.A=-1; // we use this to check whether cell is provided or not
+#endif
+}
+
+template<typename real>
+Driver<real>::TrajectoryReader::~TrajectoryReader() {
+  if(fp && close_fp) fclose(fp);
+#ifdef __PLUMED_HAS_XDRFILE
+  if(xd) xdrfile_close(xd);
+#endif
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  if(h_in) api->close_file_read(h_in);
+#endif
+}
+
+template<typename real>
+bool Driver<real>::TrajectoryReader::open(const std::string& file,int command_line_natoms) {
+  if(fmt=="mmap-dcd" || fmt=="mmap-trr" || fmt=="mmap-raw") return openMapped(file);
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  if(api) {
+    h_in = api->open_file_read(file.c_str(), fmt.c_str(), &natoms);
+    if(!h_in) return false;
+    if(natoms==MOLFILE_NUMATOMS_UNKNOWN) {
+      if(command_line_natoms>=0) natoms=command_line_natoms;
+      else driver.error("this file format does not provide number of atoms; use --natoms on the command line");
+    }
+    ts_in_coords.reset(new float [3*natoms]);
+    ts_in.coords = ts_in_coords.get();
+    return true;
+  }
+#endif
+  if(fmt=="xdr-xtc" || fmt=="xdr-trr") {
+#ifdef __PLUMED_HAS_XDRFILE
+    xd=xdrfile_open(file.c_str(),"r");
+    if(!xd) return false;
+    std::string name(file);
+    if(fmt=="xdr-xtc") read_xtc_natoms(&name[0],&natoms);
+    if(fmt=="xdr-trr") read_trr_natoms(&name[0],&natoms);
+    pos.reset(new rvec[natoms]);
+#endif
+    return true;
+  }
+  fp=fopen(file.c_str(),"r");
+  close_fp=true;
+  return fp!=NULL;
+}
+
+template<typename real>
+bool Driver<real>::TrajectoryReader::read(Frame& frame) {
+  std::vector<real> & coordinates(frame.coordinates);
+  std::vector<real> & cell(frame.cell);
+  cell.assign(9,real(0.0));
+  frame.positions=NULL;
+  if(mapped.isOpen()) {
+    if(mapped_next>=mapped_nframes) return false;
+    readMapped(frame);
+    mapped_next++;
+    return true;
+  }
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  if(api) {
+    int rc;
+    rc = api->read_next_timestep(h_in, natoms, &ts_in);
+    if(rc==MOLFILE_EOF) return false;
+    frame.natoms=natoms;
+    if(pbc_cli_given==false) {
+      if(ts_in.A>0.0) { // this is negative if molfile does not provide box
+        cellFromDimensions(ts_in.A,ts_in.B,ts_in.C,ts_in.alpha,ts_in.beta,ts_in.gamma,cell);
+      }
+    } else {
+      for(unsigned i=0; i<9; i++)cell[i]=pbc_cli_box[i];
+    }
+    // info on coords
+    // the order is xyzxyz...
+    coordinates.resize(3*natoms);
+    for(int i=0; i<3*natoms; i++) {
+      coordinates[i]=real(ts_in.coords[i]/10.); //convert to nm
+    }
+    return true;
+  }
+#endif
+  if(fmt=="xdr-xtc" || fmt=="xdr-trr") {
+#ifdef __PLUMED_HAS_XDRFILE
+    int localstep;
+    float time;
+    matrix box;
+    float prec,lambda;
+    int ret=exdrOK;
+    if(fmt=="xdr-xtc") ret=read_xtc(xd,natoms,&localstep,&time,box,pos.get(),&prec);
+    if(fmt=="xdr-trr") ret=read_trr(xd,natoms,&localstep,&time,&lambda,box,pos.get(),NULL,NULL);
+    if(ret==exdrENDOFFILE) return false;
+    if(ret!=exdrOK) return false;
+    frame.natoms=natoms;
+    frame.has_step=true;
+    frame.step=localstep;
+    for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) cell[3*i+j]=box[i][j];
+    coordinates.resize(3*natoms);
+    for(int i=0; i<natoms; i++) for(unsigned j=0; j<3; j++)
+        coordinates[3*i+j]=real(pos[i][j]);
+    return true;
+#else
+    plumed_error();
+#endif
+  }
+
+  if(!Tools::getline(fp,line)) return false;
+  if(fmt=="gro") if(!Tools::getline(fp,line)) driver.error("premature end of trajectory file");
+  int natoms;
+  sscanf(line.c_str(),"%100d",&natoms);
+  frame.natoms=natoms;
+  coordinates.resize(3*natoms);
+
+  if(fmt=="xyz") {
+    if(!Tools::getline(fp,line)) driver.error("premature end of trajectory file");
+
+    std::vector<double> celld(9,0.0);
+    if(pbc_cli_given==false) {
+      std::vector<std::string> words;
+      words=Tools::getWords(line);
+      if(words.size()==3) {
+        sscanf(line.c_str(),"%100lf %100lf %100lf",&celld[0],&celld[4],&celld[8]);
+      } else if(words.size()==9) {
+        sscanf(line.c_str(),"%100lf %100lf %100lf %100lf %100lf %100lf %100lf %100lf %100lf",
+               &celld[0], &celld[1], &celld[2],
+               &celld[3], &celld[4], &celld[5],
+               &celld[6], &celld[7], &celld[8]);
+      } else driver.error("needed box in second line of xyz file");
+    } else {			// from command line
+      celld=pbc_cli_box;
+    }
+    for(unsigned i=0; i<9; i++)cell[i]=real(celld[i]);
+  }
+  int ddist=0;
+  // Read coordinates
+  for(int i=0; i<natoms; i++) {
+    bool ok=Tools::getline(fp,line);
+    if(!ok) driver.error("premature end of trajectory file");
+    double cc[3];
+    if(fmt=="xyz") {
+      char dummy[1000];
+      int ret=std::sscanf(line.c_str(),"%999s %100lf %100lf %100lf",dummy,&cc[0],&cc[1],&cc[2]);
+      if(ret!=4) driver.error("cannot read line"+line);
+    } else if(fmt=="gro") {
+      // do the gromacs way
+      if(!i) {
+        //
+        // calculate the distance between dots (as in gromacs gmxlib/confio.c, routine get_w_conf )
+        //
+        const char      *p1, *p2, *p3;
+        p1 = strchr(line.c_str(), '.');
+        if (p1 == NULL) driver.error("seems there are no coordinates in the gro file");
+        p2 = strchr(&p1[1], '.');
+        if (p2 == NULL) driver.error("seems there is only one coordinates in the gro file");
+        ddist = p2 - p1;
+        p3 = strchr(&p2[1], '.');
+        if (p3 == NULL) driver.error("seems there are only two coordinates in the gro file");
+        if (p3 - p2 != ddist) driver.error("not uniform spacing in fields in the gro file");
+      }
+      Tools::convert(line.substr(20,ddist),cc[0]);
+      Tools::convert(line.substr(20+ddist,ddist),cc[1]);
+      Tools::convert(line.substr(20+ddist+ddist,ddist),cc[2]);
+    } else plumed_error();
+    coordinates[3*i]=real(cc[0]);
+    coordinates[3*i+1]=real(cc[1]);
+    coordinates[3*i+2]=real(cc[2]);
+  }
+  if(fmt=="gro") {
+    if(!Tools::getline(fp,line)) driver.error("premature end of trajectory file");
+    std::vector<string> words=Tools::getWords(line);
+    if(words.size()<3) driver.error("cannot understand box format");
+    Tools::convert(words[0],cell[0]);
+    Tools::convert(words[1],cell[4]);
+    Tools::convert(words[2],cell[8]);
+    if(words.size()>3) Tools::convert(words[3],cell[1]);
+    if(words.size()>4) Tools::convert(words[4],cell[2]);
+    if(words.size()>5) Tools::convert(words[5],cell[3]);
+    if(words.size()>6) Tools::convert(words[6],cell[5]);
+    if(words.size()>7) Tools::convert(words[7],cell[6]);
+    if(words.size()>8) Tools::convert(words[8],cell[7]);
+  }
+  return true;
+}
+
+template<typename real>
+bool Driver<real>::TrajectoryReader::skip() {
+  if(mapped.isOpen()) {
+    if(mapped_next>=mapped_nframes) return false;
+    mapped_next++;
+    return true;
+  }
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+  // some plugins do not accept a NULL timestep, so the frame is read anyway but not converted
+  if(api) return api->read_next_timestep(h_in, natoms, &ts_in)!=MOLFILE_EOF;
+#endif
+  if(fmt=="xdr-xtc" || fmt=="xdr-trr") {
+    // xdrfile does not allow skipping frames
+    Frame frame;
+    return read(frame);
+  }
+  if(!Tools::getline(fp,line)) return false;
+  if(fmt=="gro") if(!Tools::getline(fp,line)) driver.error("premature end of trajectory file");
+  int natoms;
+  sscanf(line.c_str(),"%100d",&natoms);
+  // one line for each atom, plus the box line
+  for(int i=0; i<natoms+1; i++) if(!Tools::getline(fp,line)) driver.error("premature end of trajectory file");
+  return true;
+}
+
+template<typename real>
+void Driver<real>::TrajectoryReader::cellFromDimensions(float A,float B,float C,float alpha,float beta,float gamma,std::vector<real>& cell) {
+  // info on the cell: convert using pbcset.tcl from pbctools in vmd distribution
+  real cosBC=cos(alpha*pi/180.);
+  //double sinBC=sin(alpha*pi/180.);
+  real cosAC=cos(beta*pi/180.);
+  real cosAB=cos(gamma*pi/180.);
+  real sinAB=sin(gamma*pi/180.);
+  real Ax=A;
+  real Bx=B*cosAB;
+  real By=B*sinAB;
+  real Cx=C*cosAC;
+  real Cy=(C*B*cosBC-Cx*Bx)/By;
+  real Cz=sqrt(C*C-Cx*Cx-Cy*Cy);
+  cell[0]=Ax/10.; cell[1]=0.; cell[2]=0.;
+  cell[3]=Bx/10.; cell[4]=By/10.; cell[5]=0.;
+  cell[6]=Cx/10.; cell[7]=Cy/10.; cell[8]=Cz/10.;
+}
+
+template<typename real>
+void Driver<real>::TrajectoryReader::seek(unsigned long frame) {
+  plumed_assert(hasRandomAccess());
+  if(frame>mapped_nframes) driver.error("premature end of trajectory file");
+  mapped_next=frame;
+  mapped.willNeed(mapped_first+frame*mapped_frame_size,mapped_frame_size);
+}
+
+template<typename real>
+int32_t Driver<real>::TrajectoryReader::mappedInt(std::size_t offset)const {
+  if(offset+4>mapped.size()) driver.error("premature end of trajectory file");
+  return readBinary<int32_t>(mapped.getData()+offset,mapped_swap);
+}
+
+template<typename real>
+real Driver<real>::TrajectoryReader::mappedReal(std::size_t offset)const {
+  if(mapped_precision==4) return real(readBinary<float>(mapped.getData()+offset,mapped_swap));
+  else return real(readBinary<double>(mapped.getData()+offset,mapped_swap));
+}
+
+template<typename real>
+std::size_t Driver<real>::TrajectoryReader::trrHeader(std::size_t offset,int32_t* header)const {
+  if(mappedInt(offset)!=1993) driver.error("wrong magic number in trr file");
+// magic number and length of the version string, followed by the string itself
+  std::size_t off=offset+8;
+  const int32_t len=mappedInt(off);
+  off+=4+4*((len+3)/4);
+// sizes of ir, e, box, vir, pres, top, sym, x, v and f; natoms, step and nre
+  for(unsigned i=0; i<13; i++) header[i]=mappedInt(off+4*i);
+  off+=4*13;
+// precision is deduced from the size of the box or of the positions, as gromacs does
+  int32_t precision=0;
+  if(header[2]>0) precision=header[2]/9;
+  else if(header[7]>0 && header[10]>0) precision=header[7]/(3*header[10]);
+  if(precision!=4 && precision!=8) driver.error("cannot understand the precision of trr file");
+// time and lambda
+  return off+2*precision;
+}
+
+template<typename real>
+bool Driver<real>::TrajectoryReader::openMapped(const std::string& file) {
+  if(!mapped.open(file)) return false;
+  const char* data=mapped.getData();
+  const std::size_t size=mapped.size();
+  std::size_t off=0;
+  if(fmt=="mmap-dcd") {
+    if(size<92 || std::memcmp(data+4,"CORD",4)) driver.error("file "+file+" is not in dcd format");
+    mapped_swap=false;
+    if(mappedInt(0)!=84) {
+      mapped_swap=true;
+      if(mappedInt(0)!=84) driver.error("dcd file "+file+" has an unsupported header (64 bit record markers?)");
+    }
+// the header is followed by the block with the titles and by the one with the number of atoms
+    const std::size_t hdr=8;
+    const bool charmm=mappedInt(hdr+76)!=0;
+    if(mappedInt(hdr+32)!=0) driver.error("dcd files with fixed atoms are not supported");
+    dcd_ndim=(charmm && mappedInt(hdr+44)==1 ? 4 : 3);
+    off=hdr+84;
+    const int32_t titles=mappedInt(off);
+    off+=4+titles;
+    if(mappedInt(off)!=titles) driver.error("wrong record length in dcd file");
+    off+=4;
+    if(mappedInt(off)!=4 || mappedInt(off+8)!=4) driver.error("wrong record length in dcd file");
+    natoms=mappedInt(off+4);
+    off+=12;
+// the unit cell is stored in each frame as a record of (usually) six doubles
+    dcd_cell_block=0;
+    if(charmm && mappedInt(hdr+40)!=0 && off<size) dcd_cell_block=8+mappedInt(off);
+    mapped_frame_size=dcd_cell_block+dcd_ndim*(8+4*std::size_t(natoms));
+  } else if(fmt=="mmap-trr") {
+// trr files are written in big endian order
+    mapped_swap=false;
+    if(size<4) driver.error("file "+file+" is not in trr format");
+    if(mappedInt(0)!=1993) {
+      mapped_swap=true;
+      if(mappedInt(0)!=1993) driver.error("file "+file+" is not in trr format");
+    }
+    const std::size_t start=trrHeader(0,trr_header);
+    if(trr_header[0]!=0 || trr_header[1]!=0 || trr_header[5]!=0 || trr_header[6]!=0)
+      driver.error("trr file "+file+" contains unsupported sections");
+    if(trr_header[7]==0 || trr_header[10]<=0) driver.error("trr file "+file+" does not contain positions");
+    natoms=trr_header[10];
+    mapped_precision=(trr_header[2]>0 ? trr_header[2]/9 : trr_header[7]/(3*natoms));
+    mapped_frame_size=start;
+    for(unsigned i=2; i<10; i++) mapped_frame_size+=trr_header[i];
+  } else if(fmt=="mmap-raw") {
+    if(size<32 || std::memcmp(data,"PLMDTRAJ",8)) driver.error("file "+file+" is not a raw trajectory written by plumed");
+    if(readBinary<int32_t>(data+8,false)!=1) {
+      if(readBinary<int32_t>(data+8,true)==1) driver.error("raw trajectory "+file+" was written on a machine with different endianness");
+      driver.error("unsupported version of raw trajectory "+file);
+    }
+    mapped_precision=readBinary<int32_t>(data+12,false);
+    if(mapped_precision!=4 && mapped_precision!=8) driver.error("wrong precision in raw trajectory "+file);
+    natoms=readBinary<int64_t>(data+16,false);
+    off=32;
+// step, followed by the cell and by the positions
+    mapped_frame_size=8+mapped_precision*(9+3*std::size_t(natoms));
+  } else plumed_error();
+  mapped_first=off;
+  mapped_nframes=(size-mapped_first)/mapped_frame_size;
+  if(mapped_first+mapped_nframes*mapped_frame_size!=size) {
+    std::string n; Tools::convert((unsigned long) mapped_frame_size,n);
+    driver.error("the size of trajectory file "+file+" is not consistent with frames of "+n+" bytes");
+  }
+  mapped_next=0;
+  mapped.sequential();
+  return true;
+}
+
+template<typename real>
+void Driver<real>::TrajectoryReader::readMapped(Frame& frame) {
+  const char* data=mapped.getData();
+  std::size_t off=mapped_first+mapped_next*mapped_frame_size;
+  std::vector<real> & coordinates(frame.coordinates);
+  std::vector<real> & cell(frame.cell);
+  frame.natoms=natoms;
+  if(fmt=="mmap-dcd") {
+    if(dcd_cell_block>0 && mappedInt(off)==48) {
+// lengths (in A) and angles (or their cosines) are converted as in the molfile plugin
+      float uc[6];
+      for(unsigned i=0; i<6; i++) uc[i]=float(readBinary<double>(data+off+4+8*i,mapped_swap));
+      float alpha,beta,gamma;
+      if(uc[1]>=-1.0 && uc[1]<=1.0 && uc[3]>=-1.0 && uc[3]<=1.0 && uc[4]>=-1.0 && uc[4]<=1.0) {
+        alpha=90.0-asin(uc[4])*90.0/(pi/2);
+        beta=90.0-asin(uc[3])*90.0/(pi/2);
+        gamma=90.0-asin(uc[1])*90.0/(pi/2);
+      } else {
+        alpha=uc[4];
+        beta=uc[3];
+        gamma=uc[1];
+      }
+      cellFromDimensions(uc[0],uc[2],uc[5],alpha,beta,gamma,cell);
+    }
+    off+=dcd_cell_block;
+// coordinates are stored as three separate records for x, y and z
+    coordinates.resize(3*natoms);
+    for(unsigned k=0; k<3; k++) {
+      if(mappedInt(off)!=4*natoms) driver.error("wrong record length in dcd file");
+      const char* x=data+off+4;
+      for(int i=0; i<natoms; i++) coordinates[3*i+k]=real(readBinary<float>(x+4*i,mapped_swap)/10.);
+      off+=8+4*std::size_t(natoms);
+    }
+  } else if(fmt=="mmap-trr") {
+    int32_t header[13];
+    off=trrHeader(off,header);
+    if(!std::equal(header,header+11,trr_header))
+      driver.error("frames in trr file contain different data; use --itrr or --mf_trr to read it");
+    frame.has_step=true;
+    frame.step=header[11];
+    if(header[2]>0) for(unsigned i=0; i<9; i++) cell[i]=mappedReal(off+i*mapped_precision);
+    off+=header[2]+header[3]+header[4];
+    coordinates.resize(3*natoms);
+    for(int i=0; i<3*natoms; i++) coordinates[i]=mappedReal(off+i*mapped_precision);
+  } else if(fmt=="mmap-raw") {
+    frame.has_step=true;
+    frame.step=readBinary<int64_t>(data+off,false);
+    off+=8;
+    for(unsigned i=0; i<9; i++) cell[i]=mappedReal(off+i*mapped_precision);
+    off+=9*mapped_precision;
+// when precision matches positions are not copied
+    if(mapped_precision==sizeof(real)) frame.positions=reinterpret_cast<const real*>(data+off);
+    else {
+      coordinates.resize(3*natoms);
+      for(int i=0; i<3*natoms; i++) coordinates[i]=mappedReal(off+i*mapped_precision);
+    }
+  } else plumed_error();
+  if(pbc_cli_given) for(unsigned i=0; i<9; i++) cell[i]=pbc_cli_box[i];
+}
+
+template<typename real>
+Driver<real>::FramePrefetcher::FramePrefetcher(TrajectoryReader& reader,unsigned nframes):
+  reader(reader),
+  frames(nframes)
+{
+  plumed_assert(nframes>0);
+  reader_thread=std::thread(&FramePrefetcher::run,this);
+}
+
+template<typename real>
+Driver<real>::FramePrefetcher::~FramePrefetcher() {
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    stop=true;
+  }
+  cv.notify_all();
+  reader_thread.join();
+}
+
+template<typename real>
+void Driver<real>::FramePrefetcher::run() {
+  const unsigned nframes=frames.size();
+  while(true) {
+    unsigned slot;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      // the frame being used by the caller cannot be overwritten
+      cv.wait(lock,[&] {return stop || nready+(inuse?1:0)<nframes;});
+      if(stop) return;
+      slot=(first+(inuse?1:0)+nready)%nframes;
+    }
+    bool ok=false;
+    try {
+      ok=reader.read(frames[slot]);
+    } catch(...) {
+      std::unique_lock<std::mutex> lock(mtx);
+      exception=std::current_exception();
+    }
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if(ok) nready++;
+      else eof=true;
+    }
+    cv.notify_all();
+    if(!ok) return;
+  }
+}
+
+template<typename real>
+typename Driver<real>::Frame* Driver<real>::FramePrefetcher::next() {
+  std::unique_lock<std::mutex> lock(mtx);
+  // release the frame returned by the previous call
+  if(inuse) {
+    first=(first+1)%frames.size();
+    inuse=false;
+    cv.notify_all();
+  }
+  cv.wait(lock,[&] {return eof || nready>0;});
+  if(nready==0) {
+    // errors are reported after all the frames preceding them have been analyzed
+    if(exception) std::rethrow_exception(exception);
+    return NULL;
+  }
+  nready--;
+  inuse=true;
+  return &frames[first];
+}
+
 template<typename real>
 int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
@@ -316,6 +943,17 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     intracomm.Set_comm(pc.Get_comm());
   }
 
+// set up for frame parallel driver:
+  bool parallel_frames; parseFlag("--parallel-frames",parallel_frames);
+  if(parallel_frames) {
+    if(!Communicator::initialized()) error("--parallel-frames needs mpi");
+    if(multi) error("--parallel-frames cannot be used together with --multi");
+    if(noatoms) error("--parallel-frames needs a trajectory");
+    if(debug_pd || debug_dd) error("--parallel-frames cannot be used together with domain/particle decomposition");
+// each process analyzes its chunk alone
+    pc.Split(pc.Get_rank(),0,intracomm);
+  }
+
 // set up for debug replica exchange:
   bool debug_grex=parse("--debug-grex",fakein);
   int  grex_stride=0;
@@ -359,13 +997,6 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   bool use_molfile=false;
 #ifdef __PLUMED_HAS_MOLFILE_PLUGINS
   molfile_plugin_t *api=NULL;
-  void *h_in=NULL;
-  molfile_timestep_t ts_in; // this is the structure that has the timestep
-// a std::unique_ptr<float> with the same scope as ts_in
-// it is necessary in order to store the pointer to ts_in.coords
-  std::unique_ptr<float[]> ts_in_coords;
-  ts_in.coords=ts_in_coords.get();
-  ts_in.A=-1; // we use this to check whether cell is provided or not
 #endif
 
 // Read in an xyz file
@@ -382,6 +1013,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     parse("--ixtc",traj_xtc);
     parse("--itrr",traj_trr);
 #endif
+    std::string traj_dcd; parse("--idcd",traj_dcd);
+    std::string traj_trr_mmap; parse("--itrr-mmap",traj_trr_mmap);
+    std::string traj_raw; parse("--iraw",traj_raw);
 #ifdef __PLUMED_HAS_MOLFILE_PLUGINS
     for(unsigned i=0; i<plugins.size(); i++) {
       string molfile_key="--mf_"+string(plugins[i]->name);
@@ -402,6 +1036,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       if(traj_gro.length()>0) nn++;
       if(traj_xtc.length()>0) nn++;
       if(traj_trr.length()>0) nn++;
+      if(traj_dcd.length()>0) nn++;
+      if(traj_trr_mmap.length()>0) nn++;
+      if(traj_raw.length()>0) nn++;
       if(nn>1) {
         fprintf(stderr,"ERROR: cannot provide more than one trajectory file\n");
         if(grex_log)fclose(grex_log);
@@ -424,6 +1061,18 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       trajectoryFile=traj_trr;
       trajectory_fmt="xdr-trr";
     }
+    if(traj_dcd.length()>0 && trajectoryFile.length()==0) {
+      trajectoryFile=traj_dcd;
+      trajectory_fmt="mmap-dcd";
+    }
+    if(traj_trr_mmap.length()>0 && trajectoryFile.length()==0) {
+      trajectoryFile=traj_trr_mmap;
+      trajectory_fmt="mmap-trr";
+    }
+    if(traj_raw.length()>0 && trajectoryFile.length()==0) {
+      trajectoryFile=traj_raw;
+      trajectory_fmt="mmap-raw";
+    }
     if(trajectoryFile.length()==0) {
       fprintf(stderr,"ERROR: missing trajectory data\n");
       if(grex_log)fclose(grex_log);
@@ -464,6 +1113,8 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
   }
 
+  unsigned nprefetch; parse("--prefetch",nprefetch);
+
 
   if(debug_dd && debug_pd) error("cannot use debug-dd and debug-pd at the same time");
   if(debug_pd || debug_dd) {
@@ -483,6 +1134,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       p.cmd("GREX setMPIIntracomm",&intracomm.Get_comm());
       p.cmd("GREX init");
     }
+    if(parallel_frames) p.cmd("setMPIFramesComm",&pc.Get_comm());
     p.cmd("setMPIComm",&intracomm.Get_comm());
   }
   p.cmd("setMDLengthUnits",&units.getLength());
@@ -495,13 +1147,18 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 
   int natoms;
 
-  FILE* fp=NULL; FILE* fp_forces=NULL; OFile fp_dforces;
-#ifdef __PLUMED_HAS_XDRFILE
-  XDRFILE* xd=NULL;
-#endif
+  FILE* fp_forces=NULL; OFile fp_dforces;
+  std::unique_ptr<TrajectoryReader> reader;
   if(!noatoms) {
-    if (trajectoryFile=="-")
-      fp=in;
+    reader.reset(new TrajectoryReader(*this,trajectory_fmt,pbc_cli_given,pbc_cli_box));
+#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
+    if(use_molfile) reader->setMolfilePlugin(api);
+#endif
+    if (trajectoryFile=="-") {
+      if(parallel_frames) error("--parallel-frames cannot be used when reading the trajectory from standard input");
+      if(trajectory_fmt.compare(0,5,"mmap-")==0) error("memory mapped trajectories cannot be read from standard input");
+      reader->setFile(in);
+    }
     else {
       if(multi) {
         string n;
@@ -510,38 +1167,21 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
         FILE* tmp_fp=fopen(testfile.c_str(),"r");
         if(tmp_fp) { fclose(tmp_fp); trajectoryFile=testfile.c_str();}
       }
-      if(use_molfile==true) {
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-        h_in = api->open_file_read(trajectoryFile.c_str(), trajectory_fmt.c_str(), &natoms);
-        if(natoms==MOLFILE_NUMATOMS_UNKNOWN) {
-          if(command_line_natoms>=0) natoms=command_line_natoms;
-          else error("this file format does not provide number of atoms; use --natoms on the command line");
-        }
-        ts_in_coords.reset(new float [3*natoms]);
-        ts_in.coords = ts_in_coords.get();
-#endif
-      } else if(trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr") {
-#ifdef __PLUMED_HAS_XDRFILE
-        xd=xdrfile_open(trajectoryFile.c_str(),"r");
-        if(!xd) {
-          string msg="ERROR: Error opening trajectory file "+trajectoryFile;
-          fprintf(stderr,"%s\n",msg.c_str());
-          return 1;
-        }
-        if(trajectory_fmt=="xdr-xtc") read_xtc_natoms(&trajectoryFile[0],&natoms);
-        if(trajectory_fmt=="xdr-trr") read_trr_natoms(&trajectoryFile[0],&natoms);
-#endif
-      } else {
-        fp=fopen(trajectoryFile.c_str(),"r");
-        if(!fp) {
-          string msg="ERROR: Error opening trajectory file "+trajectoryFile;
-          fprintf(stderr,"%s\n",msg.c_str());
-          return 1;
-        }
+      if(!reader->open(trajectoryFile,command_line_natoms)) {
+        string msg="ERROR: Error opening trajectory file "+trajectoryFile;
+        fprintf(stderr,"%s\n",msg.c_str());
+        return 1;
       }
     }
     if(dumpforces.length()>0) {
-      if(Communicator::initialized() && pc.Get_size()>1) {
+      if(parallel_frames) {
+        // forces are merged in a single file at the end
+        if(pc.Get_rank()>0) {
+          string n;
+          Tools::convert(pc.Get_rank(),n);
+          dumpforces=FileBase::appendSuffix(dumpforces,".chunk"+n);
+        }
+      } else if(Communicator::initialized() && pc.Get_size()>1) {
         string n;
         Tools::convert(pc.Get_rank(),n);
         dumpforces+="."+n;
@@ -558,7 +1198,6 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     }
   }
 
-  std::string line;
   std::vector<real> coordinates;
   std::vector<real> forces;
   std::vector<real> masses;
@@ -581,32 +1220,51 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 // random stream to choose decompositions
   Random rnd;
 
-  while(true) {
-    if(!noatoms) {
-      if(use_molfile==true) {
+// with --parallel-frames, number of frames that this process still has to analyze
+  long int nframes_left=-1;
+  if(parallel_frames) {
+    // the first process counts the frames, unless their number is known
+    unsigned long nframes=0;
+    if(reader->hasRandomAccess()) nframes=reader->getNumberOfFrames();
+    else if(pc.Get_rank()==0) {
+      TrajectoryReader counter(*this,trajectory_fmt,pbc_cli_given,pbc_cli_box);
 #ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-        int rc;
-        rc = api->read_next_timestep(h_in, natoms, &ts_in);
-        //if(rc==MOLFILE_SUCCESS){
-        //       printf(" read this one :success \n");
-        //}
-        if(rc==MOLFILE_EOF) {
-          //printf(" read this one :eof or error \n");
-          break;
-        }
+      if(use_molfile) counter.setMolfilePlugin(api);
 #endif
-      } else if(trajectory_fmt=="xyz" || trajectory_fmt=="gro") {
-        if(!Tools::getline(fp,line)) break;
-      }
+      if(!counter.open(trajectoryFile,command_line_natoms)) error("cannot open trajectory file "+trajectoryFile);
+      while(counter.skip()) nframes++;
     }
+    pc.Bcast(nframes,0);
+    const unsigned long nproc=pc.Get_size(), rank=pc.Get_rank();
+    if(nframes<nproc) error("the trajectory has less frames than the number of processes");
+    // and each process analyzes a contiguous chunk
+    const unsigned long first=(nframes*rank)/nproc;
+    const unsigned long last=(nframes*(rank+1))/nproc;
+    if(reader->hasRandomAccess()) reader->seek(first);
+    else for(unsigned long i=0; i<first; i++) if(!reader->skip()) error("premature end of trajectory file");
+    step+=first*stride;
+    nframes_left=last-first;
+    if(pc.Get_rank()==0) fprintf(out,"\nDRIVER: Splitting %lu frames among %lu processes\n",nframes,nproc);
+  }
 
-    bool first_step=false;
+// the prefetcher is declared after the reader so that its thread is stopped first
+  std::unique_ptr<FramePrefetcher> prefetcher;
+  if(reader && nprefetch>0) prefetcher.reset(new FramePrefetcher(*reader,nprefetch));
+  Frame myframe;
+
+  while(true) {
+    Frame* frame=&myframe;
+    if(nframes_left==0) break;
+    if(nframes_left>0) nframes_left--;
     if(!noatoms) {
-      if(use_molfile==false && (trajectory_fmt=="xyz" || trajectory_fmt=="gro")) {
-        if(trajectory_fmt=="gro") if(!Tools::getline(fp,line)) error("premature end of trajectory file");
-        sscanf(line.c_str(),"%100d",&natoms);
-      }
+      if(prefetcher) {
+        frame=prefetcher->next();
+        if(!frame) break;
+      } else if(!reader->read(myframe)) break;
+      natoms=frame->natoms;
     }
+
+    bool first_step=false;
     if(checknatoms<0 && !noatoms) {
       pd_nlocal=natoms;
       pd_start=0;
@@ -648,9 +1306,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       error("number of atoms in frame " + stepstr + " does not match number of atoms in first frame");
     }
 
-    coordinates.assign(3*natoms,real(0.0));
     forces.assign(3*natoms,real(0.0));
-    cell.assign(9,real(0.0));
     virial.assign(9,real(0.0));
 
     if( first_step || rnd.U01()>0.5) {
@@ -707,131 +1363,14 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     }
 
     int plumedStopCondition=0;
+    const real* positions=NULL;
     if(!noatoms) {
-      if(use_molfile) {
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-        if(pbc_cli_given==false) {
-          if(ts_in.A>0.0) { // this is negative if molfile does not provide box
-            // info on the cell: convert using pbcset.tcl from pbctools in vmd distribution
-            real cosBC=cos(ts_in.alpha*pi/180.);
-            //double sinBC=sin(ts_in.alpha*pi/180.);
-            real cosAC=cos(ts_in.beta*pi/180.);
-            real cosAB=cos(ts_in.gamma*pi/180.);
-            real sinAB=sin(ts_in.gamma*pi/180.);
-            real Ax=ts_in.A;
-            real Bx=ts_in.B*cosAB;
-            real By=ts_in.B*sinAB;
-            real Cx=ts_in.C*cosAC;
-            real Cy=(ts_in.C*ts_in.B*cosBC-Cx*Bx)/By;
-            real Cz=sqrt(ts_in.C*ts_in.C-Cx*Cx-Cy*Cy);
-            cell[0]=Ax/10.; cell[1]=0.; cell[2]=0.;
-            cell[3]=Bx/10.; cell[4]=By/10.; cell[5]=0.;
-            cell[6]=Cx/10.; cell[7]=Cy/10.; cell[8]=Cz/10.;
-          } else {
-            cell[0]=0.0; cell[1]=0.0; cell[2]=0.0;
-            cell[3]=0.0; cell[4]=0.0; cell[5]=0.0;
-            cell[6]=0.0; cell[7]=0.0; cell[8]=0.0;
-          }
-        } else {
-          for(unsigned i=0; i<9; i++)cell[i]=pbc_cli_box[i];
-        }
-        // info on coords
-        // the order is xyzxyz...
-        for(int i=0; i<3*natoms; i++) {
-          coordinates[i]=real(ts_in.coords[i]/10.); //convert to nm
-          //cerr<<"COOR "<<coordinates[i]<<endl;
-        }
-#endif
-      } else if(trajectory_fmt=="xdr-xtc" || trajectory_fmt=="xdr-trr") {
-#ifdef __PLUMED_HAS_XDRFILE
-        int localstep;
-        float time;
-        matrix box;
-        std::unique_ptr<rvec[]> pos(new rvec[natoms]);
-        float prec,lambda;
-        int ret=exdrOK;
-        if(trajectory_fmt=="xdr-xtc") ret=read_xtc(xd,natoms,&localstep,&time,box,pos.get(),&prec);
-        if(trajectory_fmt=="xdr-trr") ret=read_trr(xd,natoms,&localstep,&time,&lambda,box,pos.get(),NULL,NULL);
-        if(stride==0) step=localstep;
-        if(ret==exdrENDOFFILE) break;
-        if(ret!=exdrOK) break;
-        for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) cell[3*i+j]=box[i][j];
-        for(int i=0; i<natoms; i++) for(unsigned j=0; j<3; j++)
-            coordinates[3*i+j]=real(pos[i][j]);
-#endif
-      } else {
-        if(trajectory_fmt=="xyz") {
-          if(!Tools::getline(fp,line)) error("premature end of trajectory file");
-
-          std::vector<double> celld(9,0.0);
-          if(pbc_cli_given==false) {
-            std::vector<std::string> words;
-            words=Tools::getWords(line);
-            if(words.size()==3) {
-              sscanf(line.c_str(),"%100lf %100lf %100lf",&celld[0],&celld[4],&celld[8]);
-            } else if(words.size()==9) {
-              sscanf(line.c_str(),"%100lf %100lf %100lf %100lf %100lf %100lf %100lf %100lf %100lf",
-                     &celld[0], &celld[1], &celld[2],
-                     &celld[3], &celld[4], &celld[5],
-                     &celld[6], &celld[7], &celld[8]);
-            } else error("needed box in second line of xyz file");
-          } else {			// from command line
-            celld=pbc_cli_box;
-          }
-          for(unsigned i=0; i<9; i++)cell[i]=real(celld[i]);
-        }
-        int ddist=0;
-        // Read coordinates
-        for(int i=0; i<natoms; i++) {
-          bool ok=Tools::getline(fp,line);
-          if(!ok) error("premature end of trajectory file");
-          double cc[3];
-          if(trajectory_fmt=="xyz") {
-            char dummy[1000];
-            int ret=std::sscanf(line.c_str(),"%999s %100lf %100lf %100lf",dummy,&cc[0],&cc[1],&cc[2]);
-            if(ret!=4) error("cannot read line"+line);
-          } else if(trajectory_fmt=="gro") {
-            // do the gromacs way
-            if(!i) {
-              //
-              // calculate the distance between dots (as in gromacs gmxlib/confio.c, routine get_w_conf )
-              //
-              const char      *p1, *p2, *p3;
-              p1 = strchr(line.c_str(), '.');
-              if (p1 == NULL) error("seems there are no coordinates in the gro file");
-              p2 = strchr(&p1[1], '.');
-              if (p2 == NULL) error("seems there is only one coordinates in the gro file");
-              ddist = p2 - p1;
-              p3 = strchr(&p2[1], '.');
-              if (p3 == NULL)error("seems there are only two coordinates in the gro file");
-              if (p3 - p2 != ddist)error("not uniform spacing in fields in the gro file");
-            }
-            Tools::convert(line.substr(20,ddist),cc[0]);
-            Tools::convert(line.substr(20+ddist,ddist),cc[1]);
-            Tools::convert(line.substr(20+ddist+ddist,ddist),cc[2]);
-          } else plumed_error();
-          if(!debug_pd || ( i>=pd_start && i<pd_start+pd_nlocal) ) {
-            coordinates[3*i]=real(cc[0]);
-            coordinates[3*i+1]=real(cc[1]);
-            coordinates[3*i+2]=real(cc[2]);
-          }
-        }
-        if(trajectory_fmt=="gro") {
-          if(!Tools::getline(fp,line)) error("premature end of trajectory file");
-          std::vector<string> words=Tools::getWords(line);
-          if(words.size()<3) error("cannot understand box format");
-          Tools::convert(words[0],cell[0]);
-          Tools::convert(words[1],cell[4]);
-          Tools::convert(words[2],cell[8]);
-          if(words.size()>3) Tools::convert(words[3],cell[1]);
-          if(words.size()>4) Tools::convert(words[4],cell[2]);
-          if(words.size()>5) Tools::convert(words[5],cell[3]);
-          if(words.size()>6) Tools::convert(words[6],cell[5]);
-          if(words.size()>7) Tools::convert(words[7],cell[6]);
-          if(words.size()>8) Tools::convert(words[8],cell[7]);
-        }
-
-      }
+      // the vectors are swapped so that the frame can be refilled without reallocations
+      coordinates.swap(frame->coordinates);
+      cell.swap(frame->cell);
+      // positions stored in a mapped file are passed to plumed without copying them
+      positions=(frame->positions ? frame->positions : coordinates.data());
+      if(stride==0 && frame->has_step) step=frame->step;
 
       p.cmd("setStepLong",&step);
       p.cmd("setStopFlag",&plumedStopCondition);
@@ -839,9 +1378,9 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
       if(debug_dd) {
         for(int i=0; i<dd_nlocal; ++i) {
           int kk=dd_gatindex[i];
-          dd_coordinates[3*i+0]=coordinates[3*kk+0];
-          dd_coordinates[3*i+1]=coordinates[3*kk+1];
-          dd_coordinates[3*i+2]=coordinates[3*kk+2];
+          dd_coordinates[3*i+0]=positions[3*kk+0];
+          dd_coordinates[3*i+1]=positions[3*kk+1];
+          dd_coordinates[3*i+2]=positions[3*kk+2];
         }
         p.cmd("setForces",&dd_forces[0]);
         p.cmd("setPositions",&dd_coordinates[0]);
@@ -853,7 +1392,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
 // Basically, for empty domains we pass null pointers
 #define fix_pd(xx) (pd_nlocal!=0?&xx:NULL)
         p.cmd("setForces",fix_pd(forces[3*pd_start]));
-        p.cmd("setPositions",fix_pd(coordinates[3*pd_start]));
+        p.cmd("setPositions",fix_pd(positions[3*pd_start]));
         p.cmd("setMasses",fix_pd(masses[pd_start]));
         p.cmd("setCharges",fix_pd(charges[pd_start]));
       }
@@ -915,6 +1454,7 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
     }
     if(debugforces.length()>0) {
       // Now call the routine to work out the derivatives numerically
+      if(positions!=coordinates.data()) coordinates.assign(positions,positions+3*natoms);
       numder.assign(3*natoms+9,real(0.0)); real base=0;
       p.cmd("getBias",&base);
       if( fabs(base)<epsilon ) printf("WARNING: bias for configuration appears to be zero so debugging forces is trivial");
@@ -943,15 +1483,30 @@ int Driver<real>::main(FILE* in,FILE*out,Communicator& pc) {
   }
   p.cmd("runFinalJobs");
 
+  prefetcher.reset();
+  reader.reset();
   if(fp_forces) fclose(fp_forces);
+  if(parallel_frames && dumpforces.length()>0) {
+    // append the forces written by the other processes, in order
+    pc.Barrier();
+    if(pc.Get_rank()==0) {
+      FILE* fp_all=fopen(dumpforces.c_str(),"a");
+      std::vector<char> buffer(1<<16);
+      for(int i=1; i<pc.Get_size(); i++) {
+        string n;
+        Tools::convert(i,n);
+        string chunkfile=FileBase::appendSuffix(dumpforces,".chunk"+n);
+        FILE* fp_chunk=fopen(chunkfile.c_str(),"r");
+        if(!fp_chunk) error("cannot open file "+chunkfile);
+        size_t nread;
+        while((nread=fread(&buffer[0],1,buffer.size(),fp_chunk))>0) fwrite(&buffer[0],1,nread,fp_all);
+        fclose(fp_chunk);
+        std::remove(chunkfile.c_str());
+      }
+      fclose(fp_all);
+    }
+  }
   if(debugforces.length()>0) fp_dforces.close();
-  if(fp && fp!=in)fclose(fp);
-#ifdef __PLUMED_HAS_XDRFILE
-  if(xd) xdrfile_close(xd);
-#endif
-#ifdef __PLUMED_HAS_MOLFILE_PLUGINS
-  if(h_in) api->close_file_read(h_in);
-#endif
   if(grex_log) fclose(grex_log);
 
   return 0;
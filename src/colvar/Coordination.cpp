@@ -66,6 +66,14 @@ The following example instructs plumed to calculate the total coordination numbe
 COORDINATION GROUPA=1-10 GROUPB=20-100 R_0=0.3 NLIST NL_CUTOFF=0.5 NL_STRIDE=100
 \endplumedfile
 
+Instead of using a fixed stride, the neighbour list can be updated only when needed. In the following
+example the list contains all the pairs within 0.5+0.1 nm and it is updated as soon as one of the atoms has moved
+by more than half of the 0.1 nm skin since the last update. Notice that in this case the positions of
+all the atoms are retrieved at every step.
+\plumedfile
+COORDINATION GROUPA=1-10 GROUPB=20-100 R_0=0.3 NLIST NL_CUTOFF=0.5 NL_SKIN=0.1
+\endplumedfile
+
 The following is a dummy example which should compute the value 0 because the self interaction
 of atom 1 is skipped. Notice that in plumed 2.0 "self interactions" were not skipped, and the
 same calculation should return 1.
@@ -104,6 +112,7 @@ public:
 // active methods:
   static void registerKeywords( Keywords& keys );
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const;
+  virtual void batchPairing(unsigned n,const double*distance2,double*result,double*dfunc,const unsigned*i0,const unsigned*i1)const;
 };
 
 PLUMED_REGISTER_ACTION(Coordination,"COORDINATION")
@@ -153,6 +162,12 @@ double Coordination::pairing(double distance,double&dfunc,unsigned i,unsigned j)
   return switchingFunction.calculateSqr(distance,dfunc);
 }
 
+void Coordination::batchPairing(unsigned n,const double*distance2,double*result,double*dfunc,const unsigned*i0,const unsigned*i1)const {
+  (void) i0; // avoid warnings
+  (void) i1; // avoid warnings
+  switchingFunction.calculateSqr(n,distance2,result,dfunc);
+}
+
 }
 
 }
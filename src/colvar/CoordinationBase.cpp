@@ -38,6 +38,7 @@ void CoordinationBase::registerKeywords( Keywords& keys ) {
   keys.addFlag("NLIST",false,"Use a neighbour list to speed up the calculation");
   keys.add("optional","NL_CUTOFF","The cutoff for the neighbour list");
   keys.add("optional","NL_STRIDE","The frequency with which we are updating the atoms in the neighbour list");
+  keys.add("optional","NL_SKIN","Alternative to NL_STRIDE: the neighbour list includes pairs within NL_CUTOFF+NL_SKIN and is updated whenever an atom moves by more than half of NL_SKIN");
   keys.add("atoms","GROUPA","First list of atoms");
   keys.add("atoms","GROUPB","Second list of atoms (if empty, N*(N-1)/2 pairs in GROUPA are counted)");
 }
@@ -67,13 +68,18 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
 // neighbor list stuff
   bool doneigh=false;
   double nl_cut=0.0;
+  double nl_skin=0.0;
   int nl_st=0;
   parseFlag("NLIST",doneigh);
   if(doneigh) {
     parse("NL_CUTOFF",nl_cut);
     if(nl_cut<=0.0) error("NL_CUTOFF should be explicitly specified and positive");
+    parse("NL_SKIN",nl_skin);
+    if(nl_skin<0.0) error("NL_SKIN should be positive");
     parse("NL_STRIDE",nl_st);
-    if(nl_st<=0) error("NL_STRIDE should be explicitly specified and positive");
+    if(nl_skin>0.0) {
+      if(nl_st>0) error("NL_STRIDE and NL_SKIN cannot be used together");
+    } else if(nl_st<=0) error("NL_STRIDE should be explicitly specified and positive");
   }
 
   addValueWithDerivatives(); setNotPeriodic();
@@ -84,6 +90,9 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
     if(doneigh)  nl.reset( new NeighborList(ga_lista,pbc,getPbc(),nl_cut,nl_st) );
     else         nl.reset( new NeighborList(ga_lista,pbc,getPbc()) );
   }
+// with pbc the neighbor list is built with link cells
+  if(doneigh && pbc && !dopair) nl->enableLinkCells();
+  if(nl_skin>0.0) nl->setSkin(nl_skin);
 
   requestAtoms(nl->getFullAtomList());
 
@@ -104,7 +113,9 @@ CoordinationBase::CoordinationBase(const ActionOptions&ao):
   if(dopair) log.printf("  with PAIR option\n");
   if(doneigh) {
     log.printf("  using neighbor lists with\n");
-    log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
+    if(nl_skin>0.0) log.printf("  cutoff %f and skin %f, updated when an atom moves by more than half of the skin\n",nl_cut,nl_skin);
+    else log.printf("  update every %d steps and cutoff %f\n",nl_st,nl_cut);
+    if(pbc && !dopair) log.printf("  neighbor list is built using link cells\n");
   }
 }
 
@@ -113,7 +124,11 @@ CoordinationBase::~CoordinationBase() {
 }
 
 void CoordinationBase::prepare() {
-  if(nl->getStride()>0) {
+  if(nl->getSkin()>0.0) {
+// all atoms are always requested, so that displacements can be checked in calculate()
+    invalidateList=firsttime || getExchangeStep();
+    firsttime=getExchangeStep();
+  } else if(nl->getStride()>0) {
     if(firsttime || (getStep()%nl->getStride()==0)) {
       requestAtoms(nl->getFullAtomList());
       invalidateList=true;
@@ -136,7 +151,9 @@ void CoordinationBase::calculate()
   vector<Vector> deriv(getNumberOfAtoms());
 // deriv.resize(getPositions().size());
 
-  if(nl->getStride()>0 && invalidateList) {
+  if(nl->getSkin()>0.0) {
+    if(invalidateList || nl->needsUpdate(getPositions())) nl->update(getPositions());
+  } else if(nl->getStride()>0 && invalidateList) {
     nl->update(getPositions());
   }
 
@@ -157,48 +174,70 @@ void CoordinationBase::calculate()
   if(nt*stride*10>nn) nt=nn/stride/10;
   if(nt==0)nt=1;
 
-  #pragma omp parallel num_threads(nt)
-  {
-    std::vector<Vector> omp_deriv(getPositions().size());
-    Tensor omp_virial;
-
-    #pragma omp for reduction(+:ncoord) nowait
-    for(unsigned int i=rank; i<nn; i+=stride) {
+// pairs assigned to this process are split in batches, and pairing is computed at once on each batch
+  const unsigned batch=64;
+  const unsigned npairs=(nn>rank ? (nn-rank-1)/stride+1 : 0);
+  const unsigned nbatches=(npairs+batch-1)/batch;
 
-      Vector distance;
-      unsigned i0=nl->getClosePair(i).first;
-      unsigned i1=nl->getClosePair(i).second;
+  if(nt>1) reduction.resize(nt,deriv.size());
+  std::vector<Tensor> omp_virial(nt);
 
-      if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
-
-      if(pbc) {
-        distance=pbcDistance(getPosition(i0),getPosition(i1));
-      } else {
-        distance=delta(getPosition(i0),getPosition(i1));
+  #pragma omp parallel num_threads(nt)
+  {
+    const unsigned t=OpenMP::getThreadNum();
+    Vector distance[batch];
+    double distance2[batch];
+    double result[batch];
+    double dfunc[batch];
+    unsigned index0[batch];
+    unsigned index1[batch];
+
+    #pragma omp for reduction(+:ncoord)
+    for(unsigned int ibatch=0; ibatch<nbatches; ibatch++) {
+
+      unsigned n=0;
+      const unsigned last=((ibatch+1)*batch<npairs ? (ibatch+1)*batch : npairs);
+      for(unsigned int k=ibatch*batch; k<last; k++) {
+        const unsigned i=rank+k*stride;
+        unsigned i0=nl->getClosePair(i).first;
+        unsigned i1=nl->getClosePair(i).second;
+
+        if(getAbsoluteIndex(i0)==getAbsoluteIndex(i1)) continue;
+
+        if(pbc) {
+          distance[n]=pbcDistance(getPosition(i0),getPosition(i1));
+        } else {
+          distance[n]=delta(getPosition(i0),getPosition(i1));
+        }
+        distance2[n]=distance[n].modulo2();
+        index0[n]=i0;
+        index1[n]=i1;
+        n++;
       }
 
-      double dfunc=0.;
-      ncoord += pairing(distance.modulo2(), dfunc,i0,i1);
-
-      Vector dd(dfunc*distance);
-      Tensor vv(dd,distance);
-      if(nt>1) {
-        omp_deriv[i0]-=dd;
-        omp_deriv[i1]+=dd;
-        omp_virial-=vv;
-      } else {
-        deriv[i0]-=dd;
-        deriv[i1]+=dd;
-        virial-=vv;
+      batchPairing(n,distance2,result,dfunc,index0,index1);
+
+      for(unsigned k=0; k<n; k++) {
+        ncoord += result[k];
+
+        Vector dd(dfunc[k]*distance[k]);
+        Tensor vv(dd,distance[k]);
+        if(nt>1) {
+          reduction.add(t,index0[k],-dd);
+          reduction.add(t,index1[k],dd);
+          omp_virial[t]-=vv;
+        } else {
+          deriv[index0[k]]-=dd;
+          deriv[index1[k]]+=dd;
+          virial-=vv;
+        }
       }
 
     }
-    #pragma omp critical
-    if(nt>1) {
-      for(unsigned i=0; i<getPositions().size(); i++) deriv[i]+=omp_deriv[i];
-      virial+=omp_virial;
-    }
+// each thread sums the contributions to its own block of atoms
+    if(nt>1 && !deriv.empty()) reduction.sum(t,OpenMP::getNumThreadsInTeam(),&deriv[0]);
   }
+  for(unsigned t=0; t<nt; t++) virial+=omp_virial[t];
 
   if(!serial) {
     comm.Sum(ncoord);
@@ -211,5 +250,12 @@ void CoordinationBase::calculate()
   setBoxDerivatives  (virial);
 
 }
+
+void CoordinationBase::batchPairing(unsigned n,const double*distance2,double*result,double*dfunc,const unsigned*i0,const unsigned*i1)const {
+  for(unsigned k=0; k<n; k++) {
+    dfunc[k]=0.;
+    result[k]=pairing(distance2[k],dfunc[k],i0[k],i1[k]);
+  }
+}
 }
 }
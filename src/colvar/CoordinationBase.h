@@ -22,6 +22,7 @@
 #ifndef __PLUMED_colvar_CoordinationBase_h
 #define __PLUMED_colvar_CoordinationBase_h
 #include "Colvar.h"
+#include "tools/ThreadReduction.h"
 #include <memory>
 
 namespace PLMD {
@@ -36,6 +37,8 @@ class CoordinationBase : public Colvar {
   std::unique_ptr<NeighborList> nl;
   bool invalidateList;
   bool firsttime;
+/// Used to sum the derivatives computed by different threads
+  ThreadReduction<Vector> reduction;
 
 public:
   explicit CoordinationBase(const ActionOptions&);
@@ -44,6 +47,10 @@ public:
   virtual void calculate();
   virtual void prepare();
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const=0;
+/// Compute pairing() on n pairs at once, given their squared distances and the indexes of their atoms.
+/// The default implementation calls pairing() on each pair. It can be overridden
+/// with a faster implementation processing all the pairs together.
+  virtual void batchPairing(unsigned n,const double*distance2,double*result,double*dfunc,const unsigned*i0,const unsigned*i1)const;
   static void registerKeywords( Keywords& keys );
 };
 
@@ -76,6 +76,7 @@ public:
 // active methods:
   static void registerKeywords( Keywords& keys );
   virtual double pairing(double distance,double&dfunc,unsigned i,unsigned j)const;
+  virtual void batchPairing(unsigned n,const double*distance2,double*result,double*dfunc,const unsigned*i0,const unsigned*i1)const;
 };
 
 PLUMED_REGISTER_ACTION(DHEnergy,"DHENERGY")
@@ -145,6 +146,29 @@ double DHEnergy::pairing(double distance2,double&dfunc,unsigned i,unsigned j)con
   return tmp;
 }
 
+void DHEnergy::batchPairing(unsigned n,const double*distance2,double*result,double*dfunc,const unsigned*i0,const unsigned*i1)const {
+// charges are gathered first, so that the loop computing the energy can be vectorized
+  double q0[SwitchingFunction::batchSize];
+  double q1[SwitchingFunction::batchSize];
+  bool same[SwitchingFunction::batchSize];
+  for(unsigned p=0; p<n; p+=SwitchingFunction::batchSize) {
+    const unsigned m=(n-p<SwitchingFunction::batchSize ? n-p : SwitchingFunction::batchSize);
+    for(unsigned l=0; l<m; l++) {
+      same[l]=(getAbsoluteIndex(i0[p+l])==getAbsoluteIndex(i1[p+l]));
+      q0[l]=getCharge(i0[p+l]);
+      q1[l]=getCharge(i1[p+l]);
+    }
+    for(unsigned l=0; l<m; l++) {
+      double distance=std::sqrt(distance2[p+l]);
+      double invdistance=1.0/distance;
+      double tmp=exp(-k*distance)*invdistance*constant*q0[l]*q1[l]/epsilon;
+      double dtmp=-(k+invdistance)*tmp;
+      result[p+l]=(same[l] ? 0.0 : tmp);
+      dfunc[p+l]=(same[l] ? 0.0 : dtmp*invdistance);
+    }
+  }
+}
+
 }
 
 }
@@ -28,6 +28,7 @@
 #include "core/PlumedMain.h"
 #include "core/SetupMolInfo.h"
 #include "tools/OpenMP.h"
+#include "tools/ThreadReduction.h"
 #include <initializer_list>
 
 #define INV_PI_SQRT_PI 0.179587122
@@ -87,6 +88,7 @@ private:
   vector<vector<unsigned> > nl;
   vector<vector<bool> > nlexpo;
   vector<vector<double> > parameter;
+  ThreadReduction<Vector> reduction;
   void setupConstants(const vector<AtomNumber> &atoms, vector<vector<double> > &parameter, bool tcorr);
   map<string, map<string, string> > setupTypeMap();
   map<string, vector<double> > setupValueMap();
@@ -188,9 +190,11 @@ void EEFSolv::calculate() {
   const unsigned nn=nl.size();
   if(nt*10>nn) nt=nn/10;
   if(nt==0)nt=1;
+  vector<Vector> deriv_atoms(size);
+  if(nt>1) reduction.resize(nt,size);
   #pragma omp parallel num_threads(nt)
   {
-    vector<Vector> deriv_omp(size);
+    const unsigned t=OpenMP::getThreadNum();
     #pragma omp for reduction(+:bias)
     for (unsigned i=0; i<size; ++i) {
       const Vector posi = getPosition(i);
@@ -255,16 +259,19 @@ void EEFSolv::calculate() {
 
         const Vector dd = deriv*dist;
         deriv_i      += dd;
-        deriv_omp[j] -= dd;
+        if(nt>1) reduction.add(t, j, -dd);
+        else deriv_atoms[j] -= dd;
       }
-      deriv_omp[i] += deriv_i;
+      if(nt>1) reduction.add(t, i, deriv_i);
+      else deriv_atoms[i] += deriv_i;
       bias += - 0.5 * fedensity;
     }
-    #pragma omp critical
-    for(unsigned i=0; i<size; i++) {
-      setAtomsDerivatives(i, -deriv_omp[i]);
-      deriv_box += Tensor(getPosition(i), -deriv_omp[i]);
-    }
+    // each thread sums the contributions to its own block of atoms
+    if(nt>1) reduction.sum(t, OpenMP::getNumThreadsInTeam(), &deriv_atoms[0]);
+  }
+  for(unsigned i=0; i<size; i++) {
+    setAtomsDerivatives(i, -deriv_atoms[i]);
+    deriv_box += Tensor(getPosition(i), -deriv_atoms[i]);
   }
 
   setBoxDerivatives(-deriv_box);
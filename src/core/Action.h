@@ -262,6 +262,10 @@ public:
 /// Check if the action needs gradient
   virtual bool checkNeedsGradients()const {return false;}
 
+/// Check if the results depend on the frames analyzed before the current one
+/// (e.g. time dependent biases or averages). Such actions cannot be used with driver --parallel-frames
+  virtual bool isHistoryDependent()const {return false;}
+
 /// Perform calculation using numerical derivatives
 /// N.B. only pass an ActionWithValue to this routine if you know exactly what you
 /// are doing.
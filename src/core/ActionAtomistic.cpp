@@ -76,7 +76,7 @@ void ActionAtomistic::requestAtoms(const vector<AtomNumber> & a) {
     else unique.insert(indexes[i]);
   }
   updateUniqueLocal();
-  atoms.unique.clear();
+  atoms.uniqueNeedsUpdate=true;
 }
 
 Vector ActionAtomistic::pbcDistance(const Vector &v1,const Vector &v2)const {
@@ -219,7 +219,17 @@ void ActionAtomistic::retrieveAtoms() {
   const vector<Vector> & p(atoms.positions);
   const vector<double> & c(atoms.charges);
   const vector<double> & m(atoms.masses);
-  for(unsigned j=0; j<indexes.size(); j++) positions[j]=p[indexes[j].index()];
+  if(atoms.mdview) {
+// real atoms are read in place from the MD code, virtual atoms from the global array
+    const Vector* mdp=atoms.mdpositions;
+    const unsigned n=atoms.natoms;
+    for(unsigned j=0; j<indexes.size(); j++) {
+      const unsigned k=indexes[j].index();
+      positions[j]=(k<n?mdp[k]:p[k]);
+    }
+  } else {
+    for(unsigned j=0; j<indexes.size(); j++) positions[j]=p[indexes[j].index()];
+  }
   for(unsigned j=0; j<indexes.size(); j++) charges[j]=c[indexes[j].index()];
   for(unsigned j=0; j<indexes.size(); j++) masses[j]=m[indexes[j].index()];
 }
@@ -247,7 +257,18 @@ void ActionAtomistic::applyForces() {
   if(donotforce) return;
   vector<Vector>   & f(atoms.forces);
   Tensor           & v(atoms.virial);
-  for(unsigned j=0; j<indexes.size(); j++) f[indexes[j].index()]+=forces[j];
+  if(atoms.mdview) {
+// forces on real atoms are accumulated in place in the MD code
+    Vector* mdf=atoms.mdforces;
+    const unsigned n=atoms.natoms;
+    for(unsigned j=0; j<indexes.size(); j++) {
+      const unsigned k=indexes[j].index();
+      if(k<n) mdf[k]+=forces[j];
+      else f[k]+=forces[j];
+    }
+  } else {
+    for(unsigned j=0; j<indexes.size(); j++) f[indexes[j].index()]+=forces[j];
+  }
   v+=virial;
   atoms.forceOnEnergy+=forceOnEnergy;
 }
@@ -151,6 +151,8 @@ public:
   void makeWhole();
 /// Allow calls to modifyGlobalForce()
   void allowToAccessGlobalForces() {atoms.zeroallforces=true;}
+/// Allow calls to modifyPosition()
+  void allowToModifyPositions() {atoms.disableMDView();}
 /// updates local unique atoms
   void updateUniqueLocal();
 public:
@@ -189,11 +191,13 @@ const Vector & ActionAtomistic::getPosition(int i)const {
 
 inline
 const Vector & ActionAtomistic::getPosition(AtomNumber i)const {
+  if(atoms.mdview && int(i.index())<atoms.natoms) return atoms.mdpositions[i.index()];
   return atoms.positions[i.index()];
 }
 
 inline
 Vector & ActionAtomistic::modifyPosition(AtomNumber i) {
+  plumed_dbg_assert(!atoms.mdview);
   return atoms.positions[i.index()];
 }
 
@@ -41,6 +41,7 @@ class PlumedMain;
 
 Atoms::Atoms(PlumedMain&plumed):
   natoms(0),
+  uniqueNeedsUpdate(true),
   md_energy(0.0),
   energy(0.0),
   dataCanBeSet(false),
@@ -61,10 +62,16 @@ Atoms::Atoms(PlumedMain&plumed):
   timestep(0.0),
   forceOnEnergy(0.0),
   zeroallforces(false),
+  mdpositions(NULL),
+  mdforces(NULL),
+  mdview(false),
+  mdviewAllowed(true),
   kbT(0.0),
   asyncSent(false),
   atomsNeeded(false),
-  ddStep(0)
+  ddStep(0),
+  requestedChanged(false),
+  idleForcesNeeded(false)
 {
 }
 
@@ -144,50 +151,137 @@ void Atoms::share() {
     return;
   }
 
-  if(!(int(gatindex.size())==natoms && shuffledAtoms==0)) {
-    for(unsigned i=0; i<actions.size(); i++) {
-      if(actions[i]->isActive()) {
-        if(!actions[i]->getUnique().empty()) {
-          atomsNeeded=true;
-          // unique are the local atoms
-          unique.insert(actions[i]->getUniqueLocal().begin(),actions[i]->getUniqueLocal().end());
-        }
+  if(dd.idle()) {
+// idle processes have no action, requests are received from the first process
+    shareRequested();
+    if(!(int(gatindex.size())==natoms && shuffledAtoms==0) && uniqueNeedsUpdate) updateUnique();
+    share(unique);
+    return;
+  }
+
+  activeActions.clear();
+  for(unsigned i=0; i<actions.size(); i++) {
+    if(actions[i]->isActive()) {
+      if(!actions[i]->getUnique().empty()) {
+        atomsNeeded=true;
+        activeActions.push_back(actions[i]);
       }
     }
+  }
+
+  if(!(int(gatindex.size())==natoms && shuffledAtoms==0)) {
+// the merged list is only rebuilt when the requests or the active actions change
+    if(uniqueNeedsUpdate || activeActions!=uniqueActions) {
+      uniqueActions.swap(activeActions);
+      updateUnique();
+    }
+  }
+
+  if(dd.ngather>0) shareRequested();
+  share(unique);
+}
+
+void Atoms::updateUnique() {
+  unique.clear();
+  if(dd.idle()) {
+    // unique are the local atoms among those requested on the first process
+    for(const auto & p : requested) if(dd.g2l[p.index()]>=0) unique.push_back(p);
   } else {
-    for(unsigned i=0; i<actions.size(); i++) {
-      if(actions[i]->isActive()) {
-        if(!actions[i]->getUnique().empty()) {
-          atomsNeeded=true;
-        }
+    // unique are the local atoms
+    for(const auto & a : uniqueActions) unique.insert(unique.end(),a->getUniqueLocal().begin(),a->getUniqueLocal().end());
+    std::sort(unique.begin(),unique.end());
+    unique.erase(std::unique(unique.begin(),unique.end()),unique.end());
+    if(dd.ngather>0) {
+      std::vector<AtomNumber> r;
+      for(const auto & a : uniqueActions) r.insert(r.end(),a->getUnique().begin(),a->getUnique().end());
+      std::sort(r.begin(),r.end());
+      r.erase(std::unique(r.begin(),r.end()),r.end());
+      if(r!=requested) {
+        requested.swap(r);
+        requestedChanged=true;
       }
     }
-
   }
+  updateUniqueIndex();
+  uniqueNeedsUpdate=false;
+}
+
+void Atoms::shareRequested() {
+  int header[3]= {atomsNeeded,requestedChanged,int(requested.size())};
+  dd.Bcast(header,3,0);
+  requestedChanged=false;
+  if(!dd.idle()) {
+    if(header[1]) {
+      std::vector<int> r(requested.size());
+      for(unsigned i=0; i<r.size(); i++) r[i]=requested[i].index();
+      dd.Bcast(r,0);
+    }
+    return;
+  }
+  atomsNeeded=header[0];
+  if(header[1]) {
+    std::vector<int> r(header[2]);
+    dd.Bcast(r,0);
+    requested.resize(r.size());
+    for(unsigned i=0; i<r.size(); i++) requested[i]=AtomNumber::index(r[i]);
+    uniqueNeedsUpdate=true;
+  }
+}
 
-  share(unique);
+void Atoms::shareStatus(bool&active) {
+  int status[3]= {active,collectEnergy,zeroallforces};
+  dd.Bcast(status,3,0);
+  plumed_massert(!status[2],"actions accessing global forces cannot be used when PLUMED_GATHER_RANKS is set");
+  active=status[0];
+  collectEnergy=status[1];
+}
+
+void Atoms::shareWithIdleRanks(std::vector<double>&v) {
+  dd.Bcast(v,0);
+}
+
+void Atoms::updateUniqueIndex() {
+  uniq_index.resize(unique.size());
+  if(dd && shuffledAtoms>0) {
+    for(unsigned i=0; i<unique.size(); i++) uniq_index[i]=dd.g2l[unique[i].index()];
+  } else {
+    for(unsigned i=0; i<unique.size(); i++) uniq_index[i]=unique[i].index();
+  }
 }
 
 void Atoms::shareAll() {
   unique.clear();
   // keep in unique only those atoms that are local
   if(dd && shuffledAtoms>0) {
-    for(int i=0; i<natoms; i++) if(dd.g2l[i]>=0) unique.insert(AtomNumber::index(i));
+    for(int i=0; i<natoms; i++) if(dd.g2l[i]>=0) unique.push_back(AtomNumber::index(i));
   } else {
-    for(int i=0; i<natoms; i++) unique.insert(AtomNumber::index(i));
+    for(int i=0; i<natoms; i++) unique.push_back(AtomNumber::index(i));
   }
+  updateUniqueIndex();
+  // requests of the actions should be merged again at next step
+  uniqueNeedsUpdate=true;
   atomsNeeded=true;
   share(unique);
 }
 
-void Atoms::share(const std::set<AtomNumber>& unique) {
+void Atoms::share(const std::vector<AtomNumber>& unique) {
   plumed_assert( positionsHaveBeenSet==3 && massesHaveBeenSet );
 
   virial.zero();
-  if(zeroallforces || int(gatindex.size())==natoms) {
-    for(int i=0; i<natoms; i++) forces[i].zero();
-  } else {
-    for(const auto & p : unique) forces[p.index()].zero();
+// when all atoms are local and in order, positions and forces of the MD code can be accessed in place.
+// this is not possible if forces should be rescaled by forceOnEnergy, which requires separate plumed forces
+  mdview=false;
+  if(mdviewAllowed && !zeroallforces && !collectEnergy && dd.ngather==0 && int(gatindex.size())==natoms && shuffledAtoms==0) {
+    mdatoms->getView(mdpositions,mdforces);
+    mdview=(mdpositions && mdforces);
+  }
+// otherwise forces are accumulated directly in the MD array
+  if(!mdview) {
+    if(zeroallforces || int(gatindex.size())==natoms) {
+      for(int i=0; i<natoms; i++) forces[i].zero();
+    } else {
+      for(const auto & p : unique) forces[p.index()].zero();
+    }
   }
   for(unsigned i=getNatoms(); i<positions.size(); i++) forces[i].zero(); // virtual atoms
   forceOnEnergy=0.0;
@@ -195,18 +289,12 @@ void Atoms::share(const std::set<AtomNumber>& unique) {
 
   if(!atomsNeeded) return;
   atomsNeeded=false;
+  if(dd.ngather>0) idleForcesNeeded=true;
 
   if(int(gatindex.size())==natoms && shuffledAtoms==0) {
-// faster version, which retrieves all atoms
-    mdatoms->getPositions(0,natoms,positions);
+// faster version, which retrieves all atoms. no copy is needed if positions are read directly from the MD array
+    if(!mdview) mdatoms->getPositions(0,natoms,positions);
   } else {
-    uniq_index.clear();
-    uniq_index.reserve(unique.size());
-    if(dd && shuffledAtoms>0) {
-      for(const auto & p : unique) uniq_index.push_back(dd.g2l[p.index()]);
-    } else {
-      for(const auto & p : unique) uniq_index.push_back(p.index());
-    }
     mdatoms->getPositions(unique,uniq_index,positions);
   }
 
@@ -222,7 +310,7 @@ void Atoms::share(const std::set<AtomNumber>& unique) {
   }
 
   if(dd && shuffledAtoms>0) {
-    if(dd.async) {
+    if(dd.async || dd.ngather>0) {
       for(unsigned i=0; i<dd.mpi_request_positions.size(); i++) dd.mpi_request_positions[i].wait();
       for(unsigned i=0; i<dd.mpi_request_index.size(); i++)     dd.mpi_request_index[i].wait();
     }
@@ -238,14 +326,33 @@ void Atoms::share(const std::set<AtomNumber>& unique) {
       }
       count++;
     }
-    if(dd.async) {
-      asyncSent=true;
-      dd.mpi_request_positions.resize(dd.Get_size());
-      dd.mpi_request_index.resize(dd.Get_size());
-      for(int i=0; i<dd.Get_size(); i++) {
+    if(dd.async || dd.ngather>0) {
+// with idle processes, positions are only sent to the first dd.ngather processes
+      const int ntargets=(dd.ngather>0?dd.ngather:dd.Get_size());
+      asyncSent=!dd.idle();
+      dd.mpi_request_positions.resize(ntargets);
+      dd.mpi_request_index.resize(ntargets);
+      for(int i=0; i<ntargets; i++) {
         dd.mpi_request_index[i]=dd.Isend(&dd.indexToBeSent[0],count,i,666);
         dd.mpi_request_positions[i]=dd.Isend(&dd.positionsToBeSent[0],ndata*count,i,667);
       }
+    } else if(dd.collective) {
+// only counts are exchanged here, the rest is completed in wait()
+      asyncSent=true;
+      const int n=(dd.Get_size());
+      dd.counts.resize(n);
+      dd.displ.resize(n);
+      dd.countsData.resize(n);
+      dd.displData.resize(n);
+      dd.Allgather(count,dd.counts);
+      dd.displ[0]=0;
+      for(int i=1; i<n; ++i) dd.displ[i]=dd.displ[i-1]+dd.counts[i-1];
+      for(int i=0; i<n; ++i) dd.countsData[i]=dd.counts[i]*ndata;
+      for(int i=0; i<n; ++i) dd.displData[i]=dd.displ[i]*ndata;
+      dd.mpi_request_index.resize(1);
+      dd.mpi_request_positions.resize(1);
+      dd.mpi_request_index[0]=dd.Iallgatherv(&dd.indexToBeSent[0],count,&dd.indexToBeReceived[0],&dd.counts[0],&dd.displ[0]);
+      dd.mpi_request_positions[0]=dd.Iallgatherv(&dd.positionsToBeSent[0],ndata*count,&dd.positionsToBeReceived[0],&dd.countsData[0],&dd.displData[0]);
     } else {
       const int n=(dd.Get_size());
       vector<int> counts(n);
@@ -289,14 +396,27 @@ void Atoms::wait() {
   if(dd && shuffledAtoms>0) {
 // receive toBeReceived
     if(asyncSent) {
-      Communicator::Status status;
       int count=0;
-      for(int i=0; i<dd.Get_size(); i++) {
-        dd.Recv(&dd.indexToBeReceived[count],dd.indexToBeReceived.size()-count,i,666,status);
-        int c=status.Get_count<int>();
-        dd.Recv(&dd.positionsToBeReceived[ndata*count],dd.positionsToBeReceived.size()-ndata*count,i,667);
-        count+=c;
+// same choice as in share(): idle processes always use point-to-point messages
+      if(dd.collective && !(dd.async || dd.ngather>0)) {
+        dd.mpi_request_index[0].wait();
+        dd.mpi_request_positions[0].wait();
+        count=dd.displ.back()+dd.counts.back();
+      } else {
+        Communicator::Status status;
+        dd.counts.resize(dd.Get_size());
+        dd.displ.resize(dd.Get_size());
+        for(int i=0; i<dd.Get_size(); i++) {
+          dd.Recv(&dd.indexToBeReceived[count],dd.indexToBeReceived.size()-count,i,666,status);
+          int c=status.Get_count<int>();
+          dd.Recv(&dd.positionsToBeReceived[ndata*count],dd.positionsToBeReceived.size()-ndata*count,i,667);
+          dd.counts[i]=c;
+          dd.displ[i]=count;
+          count+=c;
+        }
       }
+// forces on atoms received from idle processes are accumulated from scratch and sent back
+      if(dd.ngather>0) for(int i=0; i<count; i++) forces[dd.indexToBeReceived[i]].zero();
       for(int i=0; i<count; i++) {
         positions[dd.indexToBeReceived[i]][0]=dd.positionsToBeReceived[ndata*i+0];
         positions[dd.indexToBeReceived[i]][1]=dd.positionsToBeReceived[ndata*i+1];
@@ -317,7 +437,11 @@ void Atoms::wait() {
 
 void Atoms::updateForces() {
   plumed_assert( forcesHaveBeenSet==3 );
-  if(forceOnEnergy*forceOnEnergy>epsilon) {
+  if(idleForcesNeeded) updateIdleForces();
+  if(mdview) {
+// forces have been already accumulated in the MD array
+    plumed_assert(forceOnEnergy*forceOnEnergy<=epsilon);
+  } else if(forceOnEnergy*forceOnEnergy>epsilon) {
     double alpha=1.0-forceOnEnergy;
     mdatoms->rescaleForces(gatindex,alpha);
     mdatoms->updateForces(gatindex,forces);
@@ -329,6 +453,44 @@ void Atoms::updateForces() {
     plumed_assert( virialHasBeenSet );
     mdatoms->updateVirial(virial);
   }
+  for(unsigned i=0; i<dd.mpi_request_forces.size(); i++) dd.mpi_request_forces[i].wait();
+  dd.mpi_request_forces.clear();
+}
+
+void Atoms::updateIdleForces() {
+  idleForcesNeeded=false;
+// when atoms are not shuffled all the forces are sent
+  const bool all=!(shuffledAtoms>0);
+  const int rank=dd.Get_rank();
+  if(dd.idle()) {
+    const unsigned n=(all?natoms:unique.size());
+    dd.forcesToBeReceived.resize(3*n+1);
+    dd.Recv(&dd.forcesToBeReceived[0],dd.forcesToBeReceived.size(),rank%dd.ngather,668);
+    for(unsigned i=0; i<n; i++) {
+      const unsigned j=(all?i:unique[i].index());
+      forces[j][0]=dd.forcesToBeReceived[3*i+0];
+      forces[j][1]=dd.forcesToBeReceived[3*i+1];
+      forces[j][2]=dd.forcesToBeReceived[3*i+2];
+    }
+    forceOnEnergy=dd.forcesToBeReceived[3*n];
+    return;
+  }
+// each idle process is served by one of the first dd.ngather processes
+  dd.forcesToBeSent.resize((dd.Get_size()-1)/dd.ngather+1);
+  dd.mpi_request_forces.clear();
+  for(int i=rank+dd.ngather,k=0; i<dd.Get_size(); i+=dd.ngather,k++) {
+    const unsigned n=(all?natoms:dd.counts[i]);
+    std::vector<double> & buffer(dd.forcesToBeSent[k]);
+    buffer.resize(3*n+1);
+    for(unsigned j=0; j<n; j++) {
+      const unsigned l=(all?j:dd.indexToBeReceived[dd.displ[i]+j]);
+      buffer[3*j+0]=forces[l][0];
+      buffer[3*j+1]=forces[l][1];
+      buffer[3*j+2]=forces[l][2];
+    }
+    buffer[3*n]=forceOnEnergy;
+    dd.mpi_request_forces.push_back(dd.Isend(&buffer[0],buffer.size(),i,668));
+  }
 }
 
 void Atoms::setNatoms(int n) {
@@ -350,6 +512,7 @@ void Atoms::remove(ActionAtomistic*a) {
   auto f=find(actions.begin(),actions.end(),a);
   plumed_massert(f!=actions.end(),"cannot remove an action registered to atoms");
   actions.erase(f);
+  uniqueNeedsUpdate=true;
 }
 
 
@@ -357,11 +520,14 @@ void Atoms::DomainDecomposition::enable(Communicator& c) {
   on=true;
   Set_comm(c.Get_comm());
   async=Get_size()<10;
+// with many processes, point-to-point messages to every process are replaced by non-blocking collectives
+  collective=!async;
   if(std::getenv("PLUMED_ASYNC_SHARE")) {
     std::string s(std::getenv("PLUMED_ASYNC_SHARE"));
-    if(s=="yes") async=true;
-    else if(s=="no") async=false;
-    else plumed_merror("PLUMED_ASYNC_SHARE variable is set to " + s + "; should be yes or no");
+    if(s=="yes") {async=true; collective=false;}
+    else if(s=="no") {async=false; collective=false;}
+    else if(s=="collective") {async=false; collective=true;}
+    else plumed_merror("PLUMED_ASYNC_SHARE variable is set to " + s + "; should be yes, no or collective");
   }
 }
 
@@ -381,6 +547,11 @@ void Atoms::setAtomsNlocal(int n) {
   };
 }
 
+void Atoms::setGatherRanks(int n) {
+  plumed_massert(dd,"PLUMED_GATHER_RANKS can only be used with domain decomposition");
+  dd.ngather=n;
+}
+
 void Atoms::setAtomsGatindex(int*g,bool fortran) {
   plumed_massert( g || gatindex.size()==0, "NULL gatindex pointer with non-zero local atoms");
   ddStep=plumed.getStep();
@@ -407,7 +578,7 @@ void Atoms::setAtomsGatindex(int*g,bool fortran) {
     // keep in unique only those atoms that are local
     actions[i]->updateUniqueLocal();
   }
-  unique.clear();
+  uniqueNeedsUpdate=true;
 }
 
 void Atoms::setAtomsContiguous(int start) {
@@ -420,7 +591,7 @@ void Atoms::setAtomsContiguous(int start) {
     // keep in unique only those atoms that are local
     actions[i]->updateUniqueLocal();
   }
-  unique.clear();
+  uniqueNeedsUpdate=true;
 }
 
 void Atoms::setRealPrecision(int p) {
@@ -439,6 +610,17 @@ void Atoms::double2MD(const double&d,void*m)const {
 }
 
 void Atoms::updateUnits() {
+  if(dd.ngather>0) {
+// idle processes do not read the input file, units are taken from the first process
+    std::vector<double> u= {units.getEnergy(),units.getLength(),units.getTime(),units.getCharge(),units.getMass(),double(naturalUnits)};
+    dd.Bcast(u,0);
+    units.setEnergy(u[0]);
+    units.setLength(u[1]);
+    units.setTime(u[2]);
+    units.setCharge(u[3]);
+    units.setMass(u[4]);
+    naturalUnits=(u[5]!=0.0);
+  }
   mdatoms->setUnits(units,MDUnits);
 }
 
@@ -524,13 +706,16 @@ void Atoms::removeGroup(const std::string&name) {
 }
 
 void Atoms::writeBinary(std::ostream&o)const {
-  o.write(reinterpret_cast<const char*>(&positions[0][0]),natoms*3*sizeof(double));
+  const Vector* p=(mdview?mdpositions:&positions[0]);
+  o.write(reinterpret_cast<const char*>(&p[0][0]),natoms*3*sizeof(double));
   o.write(reinterpret_cast<const char*>(&box(0,0)),9*sizeof(double));
   o.write(reinterpret_cast<const char*>(&energy),sizeof(double));
 }
 
 void Atoms::readBinary(std::istream&i) {
   i.read(reinterpret_cast<char*>(&positions[0][0]),natoms*3*sizeof(double));
+// positions of real atoms should now be taken from the global array
+  mdview=false;
   i.read(reinterpret_cast<char*>(&box(0,0)),9*sizeof(double));
   i.read(reinterpret_cast<char*>(&energy),sizeof(double));
   pbc.setBox(box);
@@ -49,8 +49,15 @@ class Atoms
   friend class ActionAtomistic;
   friend class ActionWithVirtualAtom;
   int natoms;
-  std::set<AtomNumber> unique;
+/// Sorted list of the local atoms requested by active actions
+  std::vector<AtomNumber> unique;
   std::vector<unsigned> uniq_index;
+/// Active actions whose requests are merged in unique
+  std::vector<const ActionAtomistic*> uniqueActions;
+/// Temporary list of active actions, reused at every step
+  std::vector<const ActionAtomistic*> activeActions;
+/// True when unique should be rebuilt from the requests of the actions
+  bool uniqueNeedsUpdate;
   std::vector<Vector> positions;
   std::vector<Vector> forces;
   std::vector<double> masses;
@@ -101,6 +108,14 @@ class Atoms
 /// for actions accessing to modifyGlobalForce() (e.g. FIT_TO_TEMPLATE).
   bool zeroallforces;
 
+/// Positions and forces arrays of the MD code.
+/// When mdview is true, they are accessed in place instead of positions and forces for real atoms
+  const Vector* mdpositions;
+  Vector* mdforces;
+  bool mdview;
+/// if set to false, positions and forces are always copied from and to the MD code
+  bool mdviewAllowed;
+
   double kbT;
 
   std::vector<ActionAtomistic*> actions;
@@ -115,26 +130,60 @@ class Atoms
   public:
     bool on;
     bool async;
+/// if true, atoms are exchanged with non-blocking collectives started in share() and completed in wait()
+    bool collective;
+/// if larger than zero, only the first ngather processes receive the positions and calculate the actions,
+/// whereas the other (idle) processes only receive the forces on their local atoms
+    int ngather;
     std::vector<int>    g2l;
 
     std::vector<Communicator::Request> mpi_request_positions;
     std::vector<Communicator::Request> mpi_request_index;
 
+/// counts and displacements for non-blocking collectives, that should stay alive until wait().
+/// They are also used to remember which atoms were received from each process when there are idle processes
+    std::vector<int> counts;
+    std::vector<int> displ;
+    std::vector<int> countsData;
+    std::vector<int> displData;
+
     std::vector<double> positionsToBeSent;
     std::vector<double> positionsToBeReceived;
     std::vector<int>    indexToBeSent;
     std::vector<int>    indexToBeReceived;
+/// forces sent to idle processes, one buffer per process
+    std::vector<std::vector<double> > forcesToBeSent;
+    std::vector<double> forcesToBeReceived;
+    std::vector<Communicator::Request> mpi_request_forces;
     operator bool() const {return on;}
     DomainDecomposition():
-      on(false), async(false)
+      on(false), async(false), collective(false), ngather(0)
     {}
     void enable(Communicator& c);
+/// true if this process does not calculate the actions
+    bool idle()const {return ngather>0 && Get_rank()>=ngather;}
   };
 
   DomainDecomposition dd;
   long int ddStep;  //last step in which dd happened
 
-  void share(const std::set<AtomNumber>&);
+/// Sorted list of all the atoms requested by active actions, used to tell idle processes
+/// which of their local atoms should be shared
+  std::vector<AtomNumber> requested;
+/// True if requested has changed and should be sent again to idle processes
+  bool requestedChanged;
+/// True if positions have been sent to the first dd.ngather processes and forces should be sent back
+  bool idleForcesNeeded;
+
+  void share(const std::vector<AtomNumber>&);
+/// Send the requested atoms to idle processes and select their local atoms
+  void shareRequested();
+/// Send the forces on the atoms of idle processes
+  void updateIdleForces();
+/// Merge the requests of uniqueActions into unique
+  void updateUnique();
+/// Compute the local indexes of the atoms in unique
+  void updateUniqueIndex();
 
 public:
 
@@ -167,6 +216,9 @@ public:
   void getLocalPositions(std::vector<Vector>&);
   void getLocalForces(std::vector<Vector>&);
   void getLocalMDForces(std::vector<Vector>&);
+/// Always copy positions and forces from and to the MD code.
+/// It is required by actions accessing to the global positions and forces arrays.
+  void disableMDView() {mdviewAllowed=false;}
   const Tensor& getVirial()const;
 
   void setCollectEnergy(bool b) { collectEnergy=b; }
@@ -175,6 +227,16 @@ public:
   void setAtomsGatindex(int*,bool);
   void setAtomsContiguous(int);
   void setAtomsNlocal(int);
+/// Only the first n processes of the domain decomposition receive the positions and calculate the actions
+  void setGatherRanks(int n);
+/// True if some processes do not calculate the actions
+  bool hasIdleRanks()const {return dd.ngather>0;}
+/// True if this process does not calculate the actions
+  bool isIdleRank()const {return dd.idle();}
+/// Tell to idle processes whether the calculation is active and whether energy is needed
+  void shareStatus(bool&active);
+/// Broadcast quantities calculated by the first process to the idle processes
+  void shareWithIdleRanks(std::vector<double>&);
 
   void startStep();
   void setEnergy(void*);
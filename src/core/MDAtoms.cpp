@@ -70,15 +70,16 @@ public:
   }
   void getBox(Tensor &)const;
   void getPositions(const vector<int>&index,vector<Vector>&positions)const;
-  void getPositions(const std::set<AtomNumber>&index,const vector<unsigned>&i,vector<Vector>&positions)const;
+  void getPositions(const std::vector<AtomNumber>&index,const vector<unsigned>&i,vector<Vector>&positions)const;
   void getPositions(unsigned j,unsigned k,vector<Vector>&positions)const;
   void getLocalPositions(std::vector<Vector>&p)const;
   void getMasses(const vector<int>&index,vector<double>&)const;
   void getCharges(const vector<int>&index,vector<double>&)const;
   void updateVirial(const Tensor&)const;
   void updateForces(const vector<int>&index,const vector<Vector>&);
-  void updateForces(const std::set<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces);
+  void updateForces(const std::vector<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces);
   void rescaleForces(const vector<int>&index,double factor);
+  void getView(const Vector*&p,Vector*&f)const;
   unsigned  getRealPrecision()const;
 };
 
@@ -115,14 +116,12 @@ void MDAtomsTyped<T>::getPositions(const vector<int>&index,vector<Vector>&positi
 }
 
 template <class T>
-void MDAtomsTyped<T>::getPositions(const std::set<AtomNumber>&index,const vector<unsigned>&i, vector<Vector>&positions)const {
-// cannot be parallelized with omp because access to positions is not ordered
-  unsigned k=0;
-  for(const auto & p : index) {
-    positions[p.index()][0]=px[stride*i[k]]*scalep;
-    positions[p.index()][1]=py[stride*i[k]]*scalep;
-    positions[p.index()][2]=pz[stride*i[k]]*scalep;
-    k++;
+void MDAtomsTyped<T>::getPositions(const std::vector<AtomNumber>&index,const vector<unsigned>&i, vector<Vector>&positions)const {
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(&positions[0],index.size()))
+  for(unsigned k=0; k<index.size(); ++k) {
+    positions[index[k].index()][0]=px[stride*i[k]]*scalep;
+    positions[index[k].index()][1]=py[stride*i[k]]*scalep;
+    positions[index[k].index()][2]=pz[stride*i[k]]*scalep;
   }
 }
 
@@ -166,13 +165,12 @@ void MDAtomsTyped<T>::updateVirial(const Tensor&virial)const {
 }
 
 template <class T>
-void MDAtomsTyped<T>::updateForces(const std::set<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces) {
-  unsigned k=0;
-  for(const auto & p : index) {
-    fx[stride*i[k]]+=scalef*T(forces[p.index()][0]);
-    fy[stride*i[k]]+=scalef*T(forces[p.index()][1]);
-    fz[stride*i[k]]+=scalef*T(forces[p.index()][2]);
-    k++;
+void MDAtomsTyped<T>::updateForces(const std::vector<AtomNumber>&index,const vector<unsigned>&i,const vector<Vector>&forces) {
+  #pragma omp parallel for num_threads(OpenMP::getGoodNumThreads(fx,stride*index.size()))
+  for(unsigned k=0; k<index.size(); ++k) {
+    fx[stride*i[k]]+=scalef*T(forces[index[k].index()][0]);
+    fy[stride*i[k]]+=scalef*T(forces[index[k].index()][1]);
+    fz[stride*i[k]]+=scalef*T(forces[index[k].index()][2]);
   }
 }
 
@@ -197,6 +195,22 @@ void MDAtomsTyped<T>::rescaleForces(const vector<int>&index,double factor) {
   }
 }
 
+template <class T>
+void MDAtomsTyped<T>::getView(const Vector*&p,Vector*&f)const {
+  p=NULL;
+  f=NULL;
+}
+
+template <>
+void MDAtomsTyped<double>::getView(const Vector*&p,Vector*&f)const {
+  static_assert(sizeof(Vector)==3*sizeof(double),"Vector should be laid out as three doubles");
+  p=NULL;
+  f=NULL;
+  if(stride!=3 || scalep!=1.0 || scalef!=1.0 || !px || !fx) return;
+  p=reinterpret_cast<const Vector*>(px);
+  f=reinterpret_cast<Vector*>(fx);
+}
+
 template <class T>
 unsigned MDAtomsTyped<T>::getRealPrecision()const {
   return sizeof(T);
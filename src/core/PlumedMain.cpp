@@ -37,14 +37,19 @@
 #include "tools/Exception.h"
 #include "tools/IFile.h"
 #include "tools/Log.h"
+#include "tools/OFile.h"
 #include "tools/OpenMP.h"
 #include "tools/Tools.h"
 #include "tools/Stopwatch.h"
+#include "tools/Profiler.h"
 #include "DataFetchingObject.h"
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <set>
 #include <unordered_map>
+#include <exception>
+#include <utility>
 
 using namespace std;
 
@@ -78,7 +83,8 @@ PlumedMain::PlumedMain():
   stopFlag(NULL),
   stopNow(false),
   novirial(false),
-  detailedTimers(false)
+  detailedTimers(false),
+  parallelActions(false)
 {
   log.link(comm);
   log.setLinePrefix("PLUMED: ");
@@ -351,6 +357,15 @@ void PlumedMain::cmd(const std::string & word,void*val) {
         CHECK_NOTINIT(initialized,word);
         multi_sim_comm.Set_comm(val);
         break;
+      case cmd_setMPIFramesComm:
+        CHECK_NOTINIT(initialized,word);
+        frames_comm.Set_comm(val);
+        // output files of the other processes are written with a suffix and appended to the ones of the first process at the end
+        if(frames_comm.Get_rank()>0) {
+          std::string n; Tools::convert(frames_comm.Get_rank(),n);
+          setSuffix(".chunk"+n);
+        }
+        break;
       case cmd_setNatoms:
         CHECK_NOTINIT(initialized,word);
         CHECK_NOTNULL(val,word);
@@ -497,6 +512,43 @@ void PlumedMain::init() {
   log.printf("Running over %d %s\n",comm.Get_size(),(comm.Get_size()>1?"nodes":"node"));
   log<<"Number of threads: "<<OpenMP::getNumThreads()<<"\n";
   log<<"Cache line size: "<<OpenMP::getCachelineSize()<<"\n";
+  if(std::getenv("PLUMED_GATHER_RANKS")) {
+    int ngather=0;
+    if(!Tools::convert(std::getenv("PLUMED_GATHER_RANKS"),ngather) || ngather<0)
+      plumed_merror(std::string("PLUMED_GATHER_RANKS variable is set to ") + std::getenv("PLUMED_GATHER_RANKS") + "; should be a non negative integer");
+// only the first ngather processes receive the positions and calculate the actions,
+// using a separate communicator. The other processes only receive the forces on their atoms
+    if(ngather>0 && ngather<comm.Get_size()) {
+      comm.Split((comm.Get_rank()<ngather?0:1),comm.Get_rank(),gather_comm);
+      atoms.setGatherRanks(ngather);
+      if(atoms.isIdleRank()) {
+// idle processes keep the original communicator, but do not write the log
+        idle_log.open("/dev/null");
+        log.link(idle_log);
+      } else {
+// handles are swapped since duplicating or freeing the original communicator
+// would require all the processes
+        std::swap(comm.Get_comm(),gather_comm.Get_comm());
+      }
+      log.printf("Actions are calculated on %d processes\n",ngather);
+    }
+  }
+  if(std::getenv("PLUMED_PARALLEL_ACTIONS")) {
+    std::string s(std::getenv("PLUMED_PARALLEL_ACTIONS"));
+    if(s=="yes") parallelActions=true;
+    else if(s=="no") parallelActions=false;
+    else plumed_merror("PLUMED_PARALLEL_ACTIONS variable is set to " + s + "; should be yes or no");
+  }
+  if(parallelActions) {
+// actions might call MPI functions in calculate(), and collective operations
+// would not be matched if they were issued in different orders by different threads
+    if(comm.Get_size()>1 || multi_sim_comm.Get_size()>1 || !Communicator::threadSafe()) {
+      log<<"Independent actions cannot be calculated in parallel when running with MPI\n";
+      parallelActions=false;
+    } else if(OpenMP::getNumThreads()<2) {
+      parallelActions=false;
+    } else log<<"Independent actions are calculated in parallel\n";
+  }
   log.printf("Number of atoms: %d\n",atoms.getNatoms());
   if(grex) log.printf("GROMACS-like replica exchange is on\n");
   log.printf("File suffix: %s\n",getSuffix().c_str());
@@ -520,6 +572,8 @@ void PlumedMain::init() {
 
 void PlumedMain::readInputFile(std::string str) {
   plumed_assert(initialized);
+// idle processes do not calculate actions
+  if(atoms.isIdleRank()) return;
   log.printf("FILE: %s\n",str.c_str());
   IFile ifile;
   ifile.link(*this);
@@ -537,6 +591,7 @@ void PlumedMain::readInputFile(std::string str) {
 void PlumedMain::readInputLine(const std::string & str) {
   plumed_assert(initialized);
   if(str.empty()) return;
+  if(atoms.isIdleRank()) return;
   std::vector<std::string> words=Tools::getWords(str);
   citations.clear();
   readInputWords(words);
@@ -567,6 +622,10 @@ void PlumedMain::readInputWords(const std::vector<std::string> & words) {
       plumed_merror(msg);
     };
     action->checkRead();
+// each process of frames_comm only sees its own chunk of the trajectory
+    if(frames_comm.Get_size()>1 && action->isHistoryDependent())
+      plumed_merror("action " + action->getName() + " with label " + action->getLabel()
+                    + " depends on the previous frames and cannot be used when frames are analyzed in parallel");
     actionSet.emplace_back(std::move(action));
   };
 
@@ -583,6 +642,11 @@ Log& PlumedMain::getLog() {
   return log;
 }
 
+Profiler& PlumedMain::enableProfiler() {
+  if(!profiler) profiler.reset(new Profiler);
+  return *profiler;
+}
+
 void PlumedMain::calc() {
   prepareCalc();
   performCalc();
@@ -628,6 +692,9 @@ void PlumedMain::prepareDependencies() {
     }
   }
 
+// idle processes have no actions and should be told what to do
+  if(atoms.hasIdleRanks()) atoms.shareStatus(active);
+
   stopwatch.stop("1 Prepare dependencies");
 }
 
@@ -660,48 +727,111 @@ void PlumedMain::waitData() {
   stopwatch.stop("3 Waiting for data");
 }
 
+void PlumedMain::calculateAction(Action*p) {
+  ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
+  ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
+  {
+    if(av) av->clearInputForces();
+    if(av) av->clearDerivatives();
+  }
+  {
+    if(aa) aa->clearOutputForces();
+    if(aa) if(aa->isActive()) aa->retrieveAtoms();
+  }
+  if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
+  else p->calculate();
+  if(av)av->setGradientsIfNeeded();
+  ActionWithVirtualAtom*avv=dynamic_cast<ActionWithVirtualAtom*>(p);
+  if(avv)avv->setGradientsIfNeeded();
+}
+
 void PlumedMain::justCalculate() {
   if(!active)return;
   stopwatch.start("4 Calculating (forward loop)");
   bias=0.0;
   work=0.0;
 
-  int iaction=0;
+// per-action timers are not thread safe
+  if(parallelActions && !detailedTimers && !profiler) justCalculateParallel();
+  else {
+    int iaction=0;
 // calculate the active actions in order (assuming *backward* dependence)
-  for(const auto & pp : actionSet) {
-    Action* p(pp.get());
-    if(p->isActive()) {
-      std::string actionNumberLabel;
-      if(detailedTimers) {
-        Tools::convert(iaction,actionNumberLabel);
-        actionNumberLabel="4A "+actionNumberLabel+" "+p->getLabel();
-        stopwatch.start(actionNumberLabel);
-      }
-      ActionWithValue*av=dynamic_cast<ActionWithValue*>(p);
-      ActionAtomistic*aa=dynamic_cast<ActionAtomistic*>(p);
-      {
-        if(av) av->clearInputForces();
-        if(av) av->clearDerivatives();
-      }
-      {
-        if(aa) aa->clearOutputForces();
-        if(aa) if(aa->isActive()) aa->retrieveAtoms();
+    for(const auto & pp : actionSet) {
+      Action* p(pp.get());
+      if(p->isActive()) {
+        std::string actionNumberLabel;
+        if(detailedTimers) {
+          Tools::convert(iaction,actionNumberLabel);
+          actionNumberLabel="4A "+actionNumberLabel+" "+p->getLabel();
+          stopwatch.start(actionNumberLabel);
+        }
+        if(profiler) profiler->start();
+        calculateAction(p);
+        if(profiler) profiler->stop(Profiler::calculate,iaction,p->getLabel());
+        if(detailedTimers) stopwatch.stop(actionNumberLabel);
       }
-      if(p->checkNumericalDerivatives()) p->calculateNumericalDerivatives();
-      else p->calculate();
-      // This retrieves components called bias
+      iaction++;
+    }
+  }
+
+// This retrieves components called bias
+// (done in order so that the result does not depend on the number of threads)
+  for(const auto & p : actionSet) {
+    if(p->isActive()) {
+      ActionWithValue*av=dynamic_cast<ActionWithValue*>(p.get());
       if(av) bias+=av->getOutputQuantity("bias");
       if(av) work+=av->getOutputQuantity("work");
-      if(av)av->setGradientsIfNeeded();
-      ActionWithVirtualAtom*avv=dynamic_cast<ActionWithVirtualAtom*>(p);
-      if(avv)avv->setGradientsIfNeeded();
-      if(detailedTimers) stopwatch.stop(actionNumberLabel);
     }
-    iaction++;
   }
   stopwatch.stop("4 Calculating (forward loop)");
 }
 
+void PlumedMain::justCalculateParallel() {
+// Active actions are grouped in levels, so that each action only depends
+// on actions belonging to previous levels. Dependencies are those declared
+// with Action::addDependency (arguments, virtual atoms, etc).
+// Actions that are both ActionPilot and ActionAtomistic (e.g. WHOLEMOLECULES)
+// might modify the coordinates used by all the following actions.
+// They are thus placed alone on a separate level.
+  std::unordered_map<const Action*,unsigned> level;
+  std::vector<std::vector<Action*> > levels;
+  unsigned minLevel=0;
+  for(const auto & pp : actionSet) {
+    Action* p(pp.get());
+    if(!p->isActive()) continue;
+    bool barrier=dynamic_cast<ActionPilot*>(p) && dynamic_cast<ActionAtomistic*>(p);
+    unsigned l=(barrier?levels.size():minLevel);
+    for(const auto & d : p->getDependencies()) {
+      auto it=level.find(d);
+      if(it!=level.end() && it->second+1>l) l=it->second+1;
+    }
+    level[p]=l;
+    if(l>=levels.size()) levels.resize(l+1);
+    levels[l].push_back(p);
+    if(barrier) minLevel=l+1;
+  }
+
+  for(const auto & l : levels) {
+    unsigned nt=OpenMP::getNumThreads();
+    if(nt>l.size()) nt=l.size();
+    if(nt<2) {
+      for(const auto & p : l) calculateAction(p);
+      continue;
+    }
+// exceptions cannot leave the parallel region, they are thus stored and rethrown later
+    std::vector<std::exception_ptr> errors(l.size());
+    #pragma omp parallel for schedule(dynamic,1) num_threads(nt)
+    for(unsigned i=0; i<l.size(); i++) {
+      try {
+        calculateAction(l[i]);
+      } catch(...) {
+        errors[i]=std::current_exception();
+      }
+    }
+    for(const auto & e : errors) if(e) std::rethrow_exception(e);
+  }
+}
+
 void PlumedMain::justApply() {
   backwardPropagate();
   update();
@@ -722,12 +852,14 @@ void PlumedMain::backwardPropagate() {
         actionNumberLabel="5A "+actionNumberLabel+" "+p->getLabel();
         stopwatch.start(actionNumberLabel);
       }
+      if(profiler) profiler->start();
 
       p->apply();
       ActionAtomistic*a=dynamic_cast<ActionAtomistic*>(p);
 // still ActionAtomistic has a special treatment, since they may need to add forces on atoms
       if(a) a->applyForces();
 
+      if(profiler) profiler->stop(Profiler::apply,actionSet.size()-1-iaction,p->getLabel());
       if(detailedTimers) stopwatch.stop(actionNumberLabel);
     }
     iaction++;
@@ -736,6 +868,13 @@ void PlumedMain::backwardPropagate() {
 // this is updating the MD copy of the forces
   if(detailedTimers) stopwatch.start("5B Update forces");
   if(atoms.getNatoms()>0) atoms.updateForces();
+  if(atoms.hasIdleRanks()) {
+    std::vector<double> v= {bias,work,double(stopNow)};
+    atoms.shareWithIdleRanks(v);
+    bias=v[0];
+    work=v[1];
+    stopNow=(v[2]!=0.0);
+  }
   if(detailedTimers) stopwatch.stop("5B Update forces");
   stopwatch.stop("5 Applying (backward loop)");
 }
@@ -746,9 +885,15 @@ void PlumedMain::update() {
   stopwatch.start("6 Update");
 // update step (for statistics, etc)
   updateFlags.push(true);
+  unsigned iaction=0;
   for(const auto & p : actionSet) {
     p->beforeUpdate();
-    if(p->isActive() && p->checkUpdate() && updateFlagsTop()) p->update();
+    if(p->isActive() && p->checkUpdate() && updateFlagsTop()) {
+      if(profiler) profiler->start();
+      p->update();
+      if(profiler) profiler->stop(Profiler::update,iaction,p->getLabel());
+    }
+    iaction++;
   }
   while(!updateFlags.empty()) updateFlags.pop();
   if(!updateFlags.empty()) plumed_merror("non matching changes in the update flags");
@@ -765,6 +910,8 @@ void PlumedMain::update() {
     fflush();
     log.flush();
     for(const auto & p : actionSet) p->fflush();
+// the MD code is going to write a checkpoint, files should be complete
+    if(doCheckPoint) syncFiles();
   }
   stopwatch.stop("6 Update");
 }
@@ -836,8 +983,17 @@ void PlumedMain::fflush() {
   }
 }
 
+void PlumedMain::syncFiles() {
+  for(const auto  & p : files) {
+    OFile* ofile=dynamic_cast<OFile*>(p);
+    if(ofile) ofile->sync();
+  }
+}
+
 void PlumedMain::insertFile(FileBase&f) {
   files.insert(&f);
+// paths are recorded so as to merge also the files that are closed before the end
+  if(frames_comm.Get_size()>1 && dynamic_cast<OFile*>(&f)) outputPaths.insert(f.getPath());
 }
 
 void PlumedMain::eraseFile(FileBase&f) {
@@ -852,6 +1008,65 @@ void PlumedMain::runJobsAtEndOfCalculation() {
   for(const auto & p : actionSet) {
     p->runFinalJobs();
   }
+  if(frames_comm.Get_size()>1) mergeOutputFiles();
+}
+
+void PlumedMain::mergeOutputFiles() {
+// all the processes should have written their files before they are read
+  fflush();
+  syncFiles();
+  frames_comm.Barrier();
+  if(frames_comm.Get_rank()==0) {
+    std::set<std::string> merged;
+    for(const auto & f : files) {
+      OFile* ofile=dynamic_cast<OFile*>(f);
+      if(!ofile || !ofile->isOpen() || merged.count(ofile->getPath())) continue;
+      merged.insert(ofile->getPath());
+      mergeOutputFile(*ofile);
+    }
+// files that have been already closed are reopened in append mode
+    for(const auto & p : outputPaths) {
+      if(merged.count(p)) continue;
+      OFile ofile;
+      ofile.enforceRestart();
+      ofile.open(p);
+      mergeOutputFile(ofile);
+      ofile.close();
+    }
+  }
+  frames_comm.Barrier();
+}
+
+void PlumedMain::mergeOutputFile(OFile&ofile) {
+  const std::string ext=Tools::extension(ofile.getPath());
+  if(ext=="xtc" || ext=="trr") {
+    log<<"WARNING: binary file "<<ofile.getPath()<<" cannot be merged\n";
+    return;
+  }
+  for(int i=1; i<frames_comm.Get_size(); i++) {
+    std::string n; Tools::convert(i,n);
+    const std::string path=FileBase::appendSuffix(ofile.getPath(),".chunk"+n);
+    IFile ifile;
+    if(!ifile.FileExist(path)) continue;
+// binary files can be simply concatenated
+    if(ofile.isBinary()) {
+      ofile.appendFile(path);
+      std::remove(path.c_str());
+      continue;
+    }
+    ifile.open(path);
+    std::string line;
+// the header is only kept in the file of the first process
+    bool header=true;
+    while(ifile.getline(line)) {
+      if(header && line.compare(0,2,"#!")==0) continue;
+      header=false;
+      ofile.printf("%s\n",line.c_str());
+    }
+    ifile.close();
+    std::remove(path.c_str());
+  }
+  ofile.flush();
 }
 
 #ifdef __PLUMED_HAS_PYTHON
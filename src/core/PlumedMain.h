@@ -52,14 +52,17 @@ namespace PLMD {
 
 
 
+class Action;
 class ActionAtomistic;
 class ActionPilot;
 class Log;
+class OFile;
 class Atoms;
 class ActionSet;
 class DLLoader;
 class Communicator;
 class Stopwatch;
+class Profiler;
 class Citations;
 class ExchangePatterns;
 class FileBase;
@@ -93,6 +96,29 @@ private:
 public:
   Communicator&multi_sim_comm=*multi_sim_comm_fwd;
 
+private:
+/// Forward declaration.
+  ForwardDecl<Communicator> gather_comm_fwd;
+/// Communicator created when only some processes calculate the actions (PLUMED_GATHER_RANKS).
+/// On those processes it is swapped with comm, and thus holds the original communicator
+  Communicator&gather_comm=*gather_comm_fwd;
+/// Forward declaration.
+  ForwardDecl<Communicator> frames_comm_fwd;
+/// Communicator among the processes analyzing different chunks of the same trajectory.
+/// Their output files are merged at the end of the calculation
+  Communicator&frames_comm=*frames_comm_fwd;
+/// Append the output files written by the other processes of frames_comm to the ones written by the first
+  void mergeOutputFiles();
+/// Append to ofile the corresponding files written by the other processes of frames_comm
+  void mergeOutputFile(OFile&ofile);
+/// Paths of all the output files opened so far, only recorded when frames_comm has more than one process
+  std::set<std::string> outputPaths;
+/// Forward declaration.
+  ForwardDecl<OFile> idle_log_fwd;
+/// On processes that do not calculate the actions (PLUMED_GATHER_RANKS) the log is redirected here,
+/// so that writing it does not require communications with the other processes
+  OFile&idle_log=*idle_log_fwd;
+
 private:
 /// Forward declaration.
   ForwardDecl<DLLoader> dlloader_fwd;
@@ -104,6 +130,9 @@ private:
   ForwardDecl<Stopwatch> stopwatch_fwd;
   Stopwatch& stopwatch=*stopwatch_fwd;
 
+/// Per-action profiler, allocated only when profiling is requested
+  std::unique_ptr<Profiler> profiler;
+
   std::unique_ptr<WithCmd> grex;
 /// Flag to avoid double initialization
   bool  initialized;
@@ -185,6 +214,12 @@ private:
 /// Store information used in class \ref generic::UpdateIf
   std::stack<bool> updateFlags;
 
+/// Calculate a single action during the forward loop
+  void calculateAction(Action*);
+/// Perform the forward loop calculating concurrently the actions
+/// that do not depend on each other
+  void justCalculateParallel();
+
 public:
 /// Flag to switch off virial calculation (for debug and MD codes with no barostat)
   bool novirial;
@@ -192,6 +227,10 @@ public:
 /// Flag to switch on detailed timers
   bool detailedTimers;
 
+/// Flag to calculate independent actions concurrently.
+/// Set with the PLUMED_PARALLEL_ACTIONS environment variable
+  bool parallelActions;
+
 /// Generic map string -> double
 /// intended to pass information across Actions
   std::map<std::string,double> passMap;
@@ -319,6 +358,8 @@ public:
   const ActionSet & getActionSet()const;
 /// Referenge to the log stream
   Log & getLog();
+/// Switch on per-action profiling and return a reference to the profiler
+  Profiler & enableProfiler();
 /// Return the number of the step
   long int getStep()const {return step;}
 /// Stop the run
@@ -345,6 +386,8 @@ public:
   void eraseFile(FileBase&);
 /// Flush all files
   void fflush();
+/// Wait until the files written asynchronously have been written and flushed
+  void syncFiles();
 /// Check if restarting
   bool getRestart()const;
 /// Set restart flag
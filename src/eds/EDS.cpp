@@ -185,6 +185,7 @@ public:
   explicit EDS(const ActionOptions&);
   void calculate();
   void update();
+  bool isHistoryDependent()const {return true;}
   void turnOnDerivatives();
   static void registerKeywords(Keywords& keys);
   ~EDS();
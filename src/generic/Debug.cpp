@@ -23,6 +23,7 @@
 #include "core/ActionPilot.h"
 #include "core/ActionSet.h"
 #include "core/PlumedMain.h"
+#include "tools/Profiler.h"
 
 using namespace std;
 
@@ -44,6 +45,23 @@ DEBUG DETAILED_TIMERS
 DEBUG logRequestedAtoms STRIDE=2
 \endplumedfile
 
+Timings of the calculate, apply and update phases of every action can be
+written on a comma separated file using PROFILE_FILE.
+For every action and phase the file reports the step,
+the index and label of the action, the phase, the number of calls
+and the total, average, minimum and maximum time in seconds,
+followed by the estimated 50th, 90th and 99th percentiles.
+Percentiles are computed from a logarithmic histogram and are thus accurate within roughly 10%.
+The statistics are cumulative and are written at the end of the simulation and,
+if PROFILE_STRIDE is given, also every PROFILE_STRIDE steps (which should be a multiple of STRIDE).
+Contrarily to DETAILED_TIMERS, no string is built during the calculation,
+so that the overhead is small enough to be used in production runs.
+
+\plumedfile
+# write action-by-action timing statistics every 1000 steps
+DEBUG PROFILE_FILE=profile.csv PROFILE_STRIDE=1000
+\endplumedfile
+
 */
 //+ENDPLUMEDOC
 class Debug:
@@ -54,12 +72,18 @@ class Debug:
   bool logRequestedAtoms;
   bool novirial;
   bool detailedTimers;
+  OFile profileFile;
+  int profileStride;
+  long int profileStep;
+  void writeProfile();
 public:
   explicit Debug(const ActionOptions&ao);
+  ~Debug();
 /// Register all the relevant keywords for the action
   static void registerKeywords( Keywords& keys );
   void calculate() {}
   void apply();
+  void update();
 };
 
 PLUMED_REGISTER_ACTION(Debug,"DEBUG")
@@ -73,6 +97,8 @@ void Debug::registerKeywords( Keywords& keys ) {
   keys.addFlag("NOVIRIAL",false,"switch off the virial contribution for the entirity of the simulation");
   keys.addFlag("DETAILED_TIMERS",false,"switch on detailed timers");
   keys.add("optional","FILE","the name of the file on which to output these quantities");
+  keys.add("optional","PROFILE_FILE","the name of the file on which to write action-by-action timing statistics");
+  keys.add("optional","PROFILE_STRIDE","the frequency with which timing statistics are written on PROFILE_FILE. By default they are only written at the end of the simulation");
 }
 
 Debug::Debug(const ActionOptions&ao):
@@ -80,7 +106,9 @@ Debug::Debug(const ActionOptions&ao):
   ActionPilot(ao),
   logActivity(false),
   logRequestedAtoms(false),
-  novirial(false) {
+  novirial(false),
+  profileStride(0),
+  profileStep(-1) {
   parseFlag("logActivity",logActivity);
   if(logActivity) log.printf("  logging activity\n");
   parseFlag("logRequestedAtoms",logRequestedAtoms);
@@ -90,7 +118,7 @@ Debug::Debug(const ActionOptions&ao):
   if(novirial) plumed.novirial=true;
   parseFlag("DETAILED_TIMERS",detailedTimers);
   if(detailedTimers) log.printf("  Detailed timing on\n");
-  plumed.detailedTimers=true;
+  if(detailedTimers) plumed.detailedTimers=true;
   ofile.link(*this);
   std::string file;
   parse("FILE",file);
@@ -101,9 +129,34 @@ Debug::Debug(const ActionOptions&ao):
     log.printf("  on plumed log file\n");
     ofile.link(log);
   }
+  std::string profile;
+  parse("PROFILE_FILE",profile);
+  parse("PROFILE_STRIDE",profileStride);
+  if(profile.length()>0) {
+    plumed.enableProfiler();
+    profileFile.link(*this);
+    profileFile.open(profile);
+    log.printf("  writing action-by-action timing statistics on file %s\n",profile.c_str());
+    if(profileStride>0) log.printf("  with stride %d\n",profileStride);
+  } else if(profileStride>0) error("PROFILE_STRIDE can only be used together with PROFILE_FILE");
   checkRead();
 }
 
+Debug::~Debug() {
+// avoid writing twice the same step
+  if(profileFile.isOpen() && plumed.getStep()!=profileStep) writeProfile();
+}
+
+void Debug::writeProfile() {
+  plumed.enableProfiler().writeCSV(profileFile,plumed.getStep(),profileStep<0);
+  profileStep=plumed.getStep();
+  profileFile.flush();
+}
+
+void Debug::update() {
+  if(profileStride>0 && getStep()%profileStride==0) writeProfile();
+}
+
 void Debug::apply() {
   if(logActivity) {
     const ActionSet&actionSet(plumed.getActionSet());
@@ -28,6 +28,8 @@
 #include "core/Atoms.h"
 #include "tools/Units.h"
 #include <cstdio>
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include "core/SetupMolInfo.h"
 #include "core/ActionSet.h"
@@ -107,6 +109,20 @@ DUMPATOMS STRIDE=10 FILE=file.xtc ATOMS=1-10,c1
 \endplumedfile
 Notice that xtc files are significantly smaller than gro and xyz files.
 
+Positions can also be written in a raw binary format (extension raw),
+which stores them in double precision without any loss and can be read very quickly
+by the \ref driver with the `--iraw` option:
+\plumedfile
+DUMPATOMS STRIDE=10 FILE=file.raw ATOMS=1-100
+\endplumedfile
+The file starts with a header of 32 bytes containing the string `PLMDTRAJ`, the version of the format (1) and
+the size of real numbers (8) as 32 bit integers, and the number of atoms as a 64 bit integer (followed by 8 unused bytes).
+Each frame contains the step as a 64 bit integer, followed by the nine components of the cell and by the
+positions of the atoms (x, y and z of the first atom, then of the second one, etc).
+Numbers are written with the endianness of the machine where PLUMED is running.
+Raw files are not compressed and, as xyz files, are written in PLUMED units unless a different
+choice is made with UNITS.
+
 Finally, consider that gro and xtc file store coordinates with limited precision set by the
 `PRECISION` keyword. Default value is 3, which means "3 digits after dot" in nm (1/1000 of a nm).
 The following will write a larger xtc file with high resolution coordinates:
@@ -137,6 +153,9 @@ class DumpAtoms:
 #if defined(__PLUMED_HAS_XDRFILE)
   XDRFILE* xd;
 #endif
+/// File and buffer used for raw output
+  FILE* rawfp=NULL;
+  std::vector<double> rawbuffer;
 public:
   explicit DumpAtoms(const ActionOptions&);
   ~DumpAtoms();
@@ -158,9 +177,9 @@ void DumpAtoms::registerKeywords( Keywords& keys ) {
   keys.add("compulsory", "UNITS","PLUMED","the units in which to print out the coordinates. PLUMED means internal PLUMED units");
   keys.add("optional", "PRECISION","The number of digits in trajectory file");
 #if defined(__PLUMED_HAS_XDRFILE)
-  keys.add("optional", "TYPE","file type, either xyz, gro, xtc, or trr, can override an automatically detected file extension");
+  keys.add("optional", "TYPE","file type, either xyz, gro, raw, xtc, or trr, can override an automatically detected file extension");
 #else
-  keys.add("optional", "TYPE","file type, either xyz or gro, can override an automatically detected file extension");
+  keys.add("optional", "TYPE","file type, either xyz, gro, or raw, can override an automatically detected file extension");
 #endif
   keys.use("RESTART");
   keys.use("UPDATE_FROM");
@@ -179,7 +198,7 @@ DumpAtoms::DumpAtoms(const ActionOptions&ao):
   if(file.length()==0) error("name out output file was not specified");
   type=Tools::extension(file);
   log<<"  file name "<<file<<"\n";
-  if(type=="gro" || type=="xyz"
+  if(type=="gro" || type=="xyz" || type=="raw"
 #ifdef __PLUMED_HAS_XDRFILE
       || type=="xtc" || type=="trr"
 #endif
@@ -192,7 +211,7 @@ DumpAtoms::DumpAtoms(const ActionOptions&ao):
   string ntype;
   parse("TYPE",ntype);
   if(ntype.length()>0) {
-    if(ntype!="xyz" && ntype!="gro"
+    if(ntype!="xyz" && ntype!="gro" && ntype!="raw"
 #ifdef __PLUMED_HAS_XDRFILE
         && ntype!="xtc" && ntype!="trr"
 #endif
@@ -235,6 +254,39 @@ DumpAtoms::DumpAtoms(const ActionOptions&ao):
   of.open(file);
   std::string path=of.getPath();
   log<<"  Writing on file "<<path<<"\n";
+  if(type=="raw") {
+    std::string mode=of.getMode()+"b";
+    of.close();
+    if(comm.Get_rank()==0) {
+      rawfp=std::fopen(path.c_str(),mode.c_str());
+      if(!rawfp) error("cannot open file "+path);
+// the header is only written at the beginning of the file, not when appending
+      std::fseek(rawfp,0,SEEK_END);
+      const int32_t version=1, precision=sizeof(double);
+      const int64_t natoms=atoms.size(), unused=0;
+      if(std::ftell(rawfp)==0) {
+        bool ok=std::fwrite("PLMDTRAJ",1,8,rawfp)==8;
+        ok=ok && std::fwrite(&version,sizeof(version),1,rawfp)==1;
+        ok=ok && std::fwrite(&precision,sizeof(precision),1,rawfp)==1;
+        ok=ok && std::fwrite(&natoms,sizeof(natoms),1,rawfp)==1;
+        ok=ok && std::fwrite(&unused,sizeof(unused),1,rawfp)==1;
+        if(!ok) error("cannot write on file "+path);
+      } else {
+// when appending, frames should have the same size as those already in the file
+        char magic[8];
+        int32_t fversion=0, fprecision=0;
+        int64_t fnatoms=0;
+        FILE* fp=std::fopen(path.c_str(),"rb");
+        bool ok=fp && std::fread(magic,1,8,fp)==8 && !std::memcmp(magic,"PLMDTRAJ",8);
+        ok=ok && std::fread(&fversion,sizeof(fversion),1,fp)==1 && fversion==version;
+        ok=ok && std::fread(&fprecision,sizeof(fprecision),1,fp)==1 && fprecision==precision;
+        ok=ok && std::fread(&fnatoms,sizeof(fnatoms),1,fp)==1;
+        if(fp) std::fclose(fp);
+        if(!ok) error("file "+path+" is not a raw trajectory written by plumed, it cannot be appended");
+        if(fnatoms!=natoms) error("file "+path+" contains a different number of atoms, it cannot be appended");
+      }
+    }
+  }
 #ifdef __PLUMED_HAS_XDRFILE
   std::string mode=of.getMode();
   if(type=="xtc") {
@@ -300,6 +352,16 @@ void DumpAtoms::update() {
               lenunit*t(0,0),lenunit*t(1,1),lenunit*t(2,2),
               lenunit*t(0,1),lenunit*t(0,2),lenunit*t(1,0),
               lenunit*t(1,2),lenunit*t(2,0),lenunit*t(2,1));
+  } else if(type=="raw") {
+    if(!rawfp) return;
+    const Tensor & t(getPbc().getBox());
+    const int64_t step=getStep();
+    rawbuffer.resize(9+3*getNumberOfAtoms());
+    for(unsigned i=0; i<3; i++) for(unsigned j=0; j<3; j++) rawbuffer[3*i+j]=lenunit*t(i,j);
+    for(unsigned i=0; i<getNumberOfAtoms(); ++i) for(unsigned j=0; j<3; j++) rawbuffer[9+3*i+j]=lenunit*getPosition(i)(j);
+    if(std::fwrite(&step,sizeof(step),1,rawfp)!=1 ||
+        std::fwrite(rawbuffer.data(),sizeof(double),rawbuffer.size(),rawfp)!=rawbuffer.size())
+      error("cannot write on file "+of.getPath());
 #if defined(__PLUMED_HAS_XDRFILE)
   } else if(type=="xtc" || type=="trr") {
     matrix box;
@@ -321,6 +383,7 @@ void DumpAtoms::update() {
 }
 
 DumpAtoms::~DumpAtoms() {
+  if(rawfp) std::fclose(rawfp);
 #ifdef __PLUMED_HAS_XDRFILE
   if(type=="xtc") {
     xdrfile_close(xd);
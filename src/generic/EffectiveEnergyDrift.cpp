@@ -119,6 +119,7 @@ public:
   void calculate() {};
   void apply() {};
   void update();
+  bool isHistoryDependent()const {return true;}
 };
 
 PLUMED_REGISTER_ACTION(EffectiveEnergyDrift,"EFFECTIVE_ENERGY_DRIFT")
@@ -176,6 +177,9 @@ EffectiveEnergyDrift::EffectiveEnergyDrift(const ActionOptions&ao):
 
   log<<"Bibliography "<<cite("Ferrarotti, Bottaro, Perez-Villa, and Bussi, submitted (2014)")<<"\n";
 
+  // forces applied by plumed are read with getLocalForces() and should be kept separate from MD forces
+  atoms.disableMDView();
+
   //construct biases from ActionWithValue with a component named bias
   vector<ActionWithValue*> tmpActions=plumed.getActionSet().select<ActionWithValue*>();
   for(unsigned i=0; i<tmpActions.size(); i++) if(tmpActions[i]->exists(tmpActions[i]->getLabel()+".bias")) biases.push_back(tmpActions[i]);
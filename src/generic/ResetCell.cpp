@@ -120,6 +120,7 @@ ResetCell::ResetCell(const ActionOptions&ao):
   } else error("undefined type "+type);
 
   checkRead();
+  allowToModifyPositions();
 }
 
 
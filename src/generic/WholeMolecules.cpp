@@ -173,6 +173,7 @@ WholeMolecules::WholeMolecules(const ActionOptions&ao):
   requestAtoms(merge);
   doNotRetrieve();
   doNotForce();
+  allowToModifyPositions();
 }
 
 void WholeMolecules::calculate() {
@@ -205,6 +205,7 @@ WrapAround::WrapAround(const ActionOptions&ao):
   requestAtoms(merged);
   doNotRetrieve();
   doNotForce();
+  allowToModifyPositions();
 }
 
 void WrapAround::calculate() {
@@ -408,6 +408,24 @@ void GridVessel::getNeighbors( const std::vector<unsigned>& indices, const std::
   }
 }
 
+std::vector<int> GridVessel::getStencil( const std::vector<unsigned>& nneigh ) const {
+  plumed_dbg_assert( gtype==flat && nneigh.size()==dimension );
+
+  unsigned num_neigh=1; std::vector<unsigned> small_bin( dimension );
+  for(unsigned i=0; i<dimension; ++i) {
+    small_bin[i]=(2*nneigh[i]+1);
+    num_neigh *=small_bin[i];
+  }
+
+  std::vector<int> stencil( num_neigh*dimension );
+  std::vector<unsigned> s_indices(dimension);
+  for(unsigned index=0; index<num_neigh; ++index) {
+    convertIndexToIndices( index, small_bin, s_indices );
+    for(unsigned i=0; i<dimension; ++i) stencil[index*dimension+i]=static_cast<int>(s_indices[i])-static_cast<int>(nneigh[i]);
+  }
+  return stencil;
+}
+
 void GridVessel::setCubeUnits( const double& units ) {
   plumed_dbg_assert( gtype==flat ); cube_units=units;
 }
@@ -24,8 +24,10 @@
 
 #include <string>
 #include <cstring>
+#include <cmath>
 #include <vector>
 #include "vesselbase/AveragingVessel.h"
+#include "tools/Tools.h"
 
 namespace PLMD {
 namespace gridtools {
@@ -158,6 +160,11 @@ public:
 /// Get the neighbors for a set of indices of a point
   void getNeighbors( const std::vector<unsigned>& indices, const std::vector<unsigned>& nneigh,
                      unsigned& num_neighbors, std::vector<unsigned>& neighbors ) const ;
+/// Get the offsets of the grid points within nneigh bins of a grid point, in the order used by getNeighbors
+  std::vector<int> getStencil( const std::vector<unsigned>& nneigh ) const ;
+/// Get the index of the grid point at a given offset from the cell that contains pp and its displacement from pp.
+/// Returns false if this grid point is outside a non periodic grid
+  bool getStencilPoint( const std::vector<double>& pp, const int* offset, unsigned& index, std::vector<double>& dist ) const ;
 /// Get the points neighboring a particular spline point
   void getSplineNeighbors( const unsigned& mybox, std::vector<unsigned>& mysneigh ) const ;
 /// Get the spacing between grid points
@@ -247,6 +254,24 @@ double GridVessel::getGridExtent( const unsigned& i ) const {
   return max[i] - min[i];
 }
 
+inline
+bool GridVessel::getStencilPoint( const std::vector<double>& pp, const int* offset, unsigned& index, std::vector<double>& dist ) const {
+  plumed_dbg_assert( gtype==flat && bounds_set && pp.size()==dimension && dist.size()==dimension );
+  index=0;
+  for(unsigned i=0; i<dimension; ++i) {
+    int i0=offset[i]+static_cast<int>( std::floor( (pp[i]-min[i])/dx[i] ) );
+    int n=nbin[i];
+    if( pbc[i] ) { i0%=n; if( i0<0 ) i0+=n; }
+    else if( i0<0 || i0>=n ) return false;
+    index+=i0*stride[i];
+    // Same convention as Value::difference
+    double x=min[i]+dx[i]*i0;
+    if( pbc[i] ) { double extent=max[i]-min[i]; dist[i]=-Tools::pbc( (pp[i]-x)*(1./extent) )*extent; }
+    else dist[i]=-(pp[i]-x);
+  }
+  return true;
+}
+
 inline
 bool GridVessel::noDerivatives() const {
   return noderiv;
@@ -52,6 +52,10 @@ HistogramOnGrid::HistogramOnGrid( const vesselbase::VesselOptions& da ):
   }
 }
 
+HistogramOnGrid::~HistogramOnGrid() {
+// destructor required to delete forward declared class
+}
+
 double HistogramOnGrid::getFibonacciCutoff() const {
   return std::log( epsilon / von_misses_norm ) / von_misses_concentration;
 }
@@ -65,12 +69,17 @@ void HistogramOnGrid::setBounds( const std::vector<std::string>& smin, const std
   GridVessel::setBounds( smin, smax, nbins, spacing );
   if( !discrete ) {
     std::vector<double> point(dimension,0);
-    KernelFunctions kernel( point, bandwidths, kerneltype, "DIAGONAL", 1.0 ); neigh_tot=1;
-    nneigh=kernel.getSupport( dx ); std::vector<double> support( kernel.getContinuousSupport() );
+    kernel.reset( new KernelFunctions( point, bandwidths, kerneltype, "DIAGONAL", 1.0 ) ); neigh_tot=1;
+    nneigh=kernel->getSupport( dx ); std::vector<double> support( kernel->getContinuousSupport() );
     for(unsigned i=0; i<dimension; ++i) {
       if( pbc[i] && 2*support[i]>getGridExtent(i) ) error("bandwidth is too large for periodic grid");
       neigh_tot *= (2*nneigh[i]+1);
     }
+    // The normalization only depends on the bandwidths so it is done once here
+    std::vector<Value*> vv( getVectorOfValues() ); kernel->normalize( vv );
+    for(unsigned i=0; i<dimension; ++i) delete vv[i];
+    // And so does the set of grid points within the support of the kernel
+    if( getType()=="flat" ) stencil=getStencil( nneigh );
   }
 }
 
@@ -80,9 +89,9 @@ std::unique_ptr<KernelFunctions> HistogramOnGrid::getKernelAndNeighbors( std::ve
     num_neigh=1; for(unsigned i=0; i<dimension; ++i) point[i] += 0.5*dx[i];
     neighbors[0] = getIndex( point ); return NULL;
   } else if( getType()=="flat" ) {
-    std::unique_ptr<KernelFunctions> kernel(new KernelFunctions( point, bandwidths, kerneltype, "DIAGONAL", 1.0 ));
-    kernel->normalize( getVectorOfValues() ); getNeighbors( kernel->getCenter(), nneigh, num_neigh, neighbors );
-    return kernel;
+    std::unique_ptr<KernelFunctions> mykernel(new KernelFunctions( kernel.get() ));
+    mykernel->setCenter( point ); getNeighbors( point, nneigh, num_neigh, neighbors );
+    return mykernel;
   } else if( getType()=="fibonacci" ) {
     getNeighbors( point, nneigh, num_neigh, neighbors );
     return NULL;
@@ -113,45 +122,55 @@ void HistogramOnGrid::calculate( const unsigned& current, MultiValue& myvals, st
     std::vector<double> point( dimension ); double weight=myvals.get(0)*myvals.get( 1+dimension );
     for(unsigned i=0; i<dimension; ++i) point[i]=myvals.get( 1+i );
 
-    // Get the kernel
-    unsigned num_neigh; std::vector<unsigned> neighbors;
     std::vector<double> der( dimension );
-    std::unique_ptr<KernelFunctions> kernel=getKernelAndNeighbors( point, num_neigh, neighbors );
-
-    if( !kernel && getType()=="flat" ) {
+    if( discrete ) {
+      unsigned num_neigh; std::vector<unsigned> neighbors(1);
+      getKernelAndNeighbors( point, num_neigh, neighbors );
       plumed_dbg_assert( num_neigh==1 ); der.resize(0);
       accumulate( neighbors[0], weight, 1.0, der, buffer );
     } else {
       double totwforce=0.0;
       std::vector<double> intforce( 2*dimension, 0.0 );
-      std::vector<Value*> vv( getVectorOfValues() );
-
-      double newval; std::vector<unsigned> tindices( dimension ); std::vector<double> xx( dimension );
-      for(unsigned i=0; i<num_neigh; ++i) {
-        unsigned ineigh=neighbors[i];
-        if( inactive( ineigh ) ) continue ;
-        getGridPointCoordinates( ineigh, tindices, xx );
-        if( kernel ) {
-          for(unsigned j=0; j<dimension; ++j) vv[j]->set(xx[j]);
-          newval = kernel->evaluate( vv, der, true );
-        } else {
+
+      double newval;
+      if( getType()=="flat" ) {
+        // Loop over the precomputed stencil of grid points around the center of the kernel
+        unsigned ineigh; std::vector<double> dist( dimension );
+        for(unsigned i=0; i<neigh_tot; ++i) {
+          if( !getStencilPoint( point, &stencil[i*dimension], ineigh, dist ) ) continue;
+          if( inactive( ineigh ) ) continue ;
+          newval = kernel->evaluateDisplacement( &dist[0], &der[0] );
+          accumulate( ineigh, weight, newval, der, buffer );
+          if( wasForced() ) {
+            accumulateForce( ineigh, weight, der, intforce );
+            totwforce += myvals.get( 1+dimension )*newval*forces[ineigh];
+          }
+        }
+      } else {
+        unsigned num_neigh; std::vector<unsigned> neighbors;
+        getKernelAndNeighbors( point, num_neigh, neighbors );
+        std::vector<double> xx( dimension );
+        for(unsigned i=0; i<num_neigh; ++i) {
+          unsigned ineigh=neighbors[i];
+          if( inactive( ineigh ) ) continue ;
+          getGridPointCoordinates( ineigh, xx );
           // Evalulate dot product
           double dot=0; for(unsigned j=0; j<dimension; ++j) { dot+=xx[j]*point[j]; der[j]=xx[j]; }
           // Von misses distribution for concentration parameter
           newval = von_misses_norm*exp( von_misses_concentration*dot );
           // And final derivatives
           for(unsigned j=0; j<dimension; ++j) der[j] *= von_misses_concentration*newval;
-        }
-        accumulate( ineigh, weight, newval, der, buffer );
-        if( wasForced() ) {
-          accumulateForce( ineigh, weight, der, intforce );
-          totwforce += myvals.get( 1+dimension )*newval*forces[ineigh];
+          accumulate( ineigh, weight, newval, der, buffer );
+          if( wasForced() ) {
+            accumulateForce( ineigh, weight, der, intforce );
+            totwforce += myvals.get( 1+dimension )*newval*forces[ineigh];
+          }
         }
       }
       if( wasForced() ) {
         // Minus sign for kernel here as we are taking derivative with respect to position of center of
         // kernel NOT derivative wrt to grid point
-        double pref = 1; if( kernel ) pref = -1;
+        double pref = 1; if( getType()=="flat" ) pref = -1;
         unsigned nder = getAction()->getNumberOfDerivatives();
         unsigned gridbuf = getNumberOfBufferPoints()*getNumberOfQuantities();
         for(unsigned j=0; j<dimension; ++j) {
@@ -169,7 +188,6 @@ void HistogramOnGrid::calculate( const unsigned& current, MultiValue& myvals, st
           buffer[ bufstart + gridbuf + nder + 1 + kder ] += myvals.getDerivative( 0, kder );
         }
       }
-      for(unsigned i=0; i<dimension; ++i) delete vv[i];
     }
   }
 }
@@ -38,6 +38,10 @@ private:
   std::string kerneltype;
   std::vector<double> bandwidths;
   std::vector<unsigned> nneigh;
+/// The normalized kernel that is used for all the points, its center is not used
+  std::unique_ptr<KernelFunctions> kernel;
+/// The offsets of the grid points within the support of the kernel
+  std::vector<int> stencil;
 protected:
   bool discrete;
 public:
@@ -45,6 +49,7 @@ public:
   double von_misses_concentration;
   static void registerKeywords( Keywords& keys );
   explicit HistogramOnGrid( const vesselbase::VesselOptions& da );
+  ~HistogramOnGrid();
   void setBounds( const std::vector<std::string>& smin, const std::vector<std::string>& smax,
                   const std::vector<unsigned>& nbins, const std::vector<double>& spacing );
   void calculate( const unsigned& current, MultiValue& myvals, std::vector<double>& buffer, std::vector<unsigned>& der_list ) const ;
@@ -254,6 +254,7 @@ public:
   ~Metainference();
   void calculate();
   void update();
+  bool isHistoryDependent()const {return true;}
   static void registerKeywords(Keywords& keys);
 };
 
@@ -64,6 +64,8 @@
 #include "CompiledExpression.h"
 #include "Operation.h"
 #include "ParsedExpression.h"
+#include <algorithm>
+#include <cmath>
 #include <utility>
 
 namespace PLMD {
@@ -219,6 +221,146 @@ double CompiledExpression::evaluate() const {
 #endif
 }
 
+// Number of points processed at once by the batch version of evaluate().
+
+static const int blockSize = 64;
+
+void CompiledExpression::evaluate(int n, const double* const* values, double* result) const {
+    // Each workspace element becomes a block of consecutive values, one per point.
+    // The blocks are kept in buffers owned by the calling thread, so that they are not allocated
+    // at every call.  They are taken out of the thread buffers while in use, so that a nested call
+    // would just allocate its own.
+
+    static thread_local vector<double> threadWorkspace;
+    static thread_local vector<const double*> threadValues;
+    vector<double> blockWorkspace;
+    vector<const double*> blockValues;
+    blockWorkspace.swap(threadWorkspace);
+    blockValues.swap(threadValues);
+    blockWorkspace.resize(workspace.size()*blockSize);
+    blockValues.resize(variableNames.size());
+    for (int start = 0; start < n; start += blockSize) {
+        for (int i = 0; i < (int) blockValues.size(); i++)
+            blockValues[i] = values[i]+start;
+        evaluateBlock(min(blockSize, n-start), blockValues.data(), result+start, blockWorkspace.data());
+    }
+    threadWorkspace.swap(blockWorkspace);
+    threadValues.swap(blockValues);
+}
+
+void CompiledExpression::evaluateBlock(int n, const double* const* values, double* result, double* blockWorkspace) const {
+    int var = 0;
+    for (set<string>::const_iterator iter = variableNames.begin(); iter != variableNames.end(); ++iter, ++var) {
+        double* dest = blockWorkspace+blockSize*variableIndices.find(*iter)->second;
+        for (int j = 0; j < n; j++)
+            dest[j] = values[var][j];
+    }
+
+    // Loop over the operations and apply each one to the whole block.
+
+    double argBuffer[8];
+    vector<double> argValuesBlock;
+    for (int step = 0; step < (int) operation.size(); step++) {
+        const Operation& op = *operation[step];
+        const vector<int>& args = arguments[step];
+        // A single entry means that the arguments are consecutive in the workspace.
+        const bool sequential = (args.size() == 1);
+        const int numArgs = (sequential ? op.getNumArguments() : args.size());
+        double* t = blockWorkspace+blockSize*target[step];
+        const double* a = blockWorkspace+blockSize*args[0];
+        const double* b = (numArgs > 1 ? blockWorkspace+blockSize*(sequential ? args[0]+1 : args[1]) : a);
+        switch (op.getId()) {
+            case Operation::CONSTANT: {
+                double value = dynamic_cast<const Operation::Constant&>(op).getValue();
+                for (int j = 0; j < n; j++)
+                    t[j] = value;
+                break;
+            }
+            case Operation::ADD:
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]+b[j];
+                break;
+            case Operation::SUBTRACT:
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]-b[j];
+                break;
+            case Operation::MULTIPLY:
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]*b[j];
+                break;
+            case Operation::DIVIDE:
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]/b[j];
+                break;
+            case Operation::NEGATE:
+                for (int j = 0; j < n; j++)
+                    t[j] = -a[j];
+                break;
+            case Operation::SQRT:
+                for (int j = 0; j < n; j++)
+                    t[j] = sqrt(a[j]);
+                break;
+            case Operation::EXP:
+                for (int j = 0; j < n; j++)
+                    t[j] = exp(a[j]);
+                break;
+            case Operation::LOG:
+                for (int j = 0; j < n; j++)
+                    t[j] = log(a[j]);
+                break;
+            case Operation::TANH:
+                for (int j = 0; j < n; j++)
+                    t[j] = tanh(a[j]);
+                break;
+            case Operation::SQUARE:
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]*a[j];
+                break;
+            case Operation::CUBE:
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]*a[j]*a[j];
+                break;
+            case Operation::RECIPROCAL:
+                for (int j = 0; j < n; j++)
+                    t[j] = 1.0/a[j];
+                break;
+            case Operation::ADD_CONSTANT: {
+                double value = dynamic_cast<const Operation::AddConstant&>(op).getValue();
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]+value;
+                break;
+            }
+            case Operation::MULTIPLY_CONSTANT: {
+                double value = dynamic_cast<const Operation::MultiplyConstant&>(op).getValue();
+                for (int j = 0; j < n; j++)
+                    t[j] = a[j]*value;
+                break;
+            }
+            case Operation::ABS:
+                for (int j = 0; j < n; j++)
+                    t[j] = fabs(a[j]);
+                break;
+            default: {
+                // Any other operation is evaluated one point at a time.
+
+                double* argValues = argBuffer;
+                if (numArgs > 8) {
+                    argValuesBlock.resize(numArgs);
+                    argValues = argValuesBlock.data();
+                }
+                for (int j = 0; j < n; j++) {
+                    for (int i = 0; i < numArgs; i++)
+                        argValues[i] = blockWorkspace[blockSize*(sequential ? args[0]+i : args[i])+j];
+                    t[j] = op.evaluate(argValues, dummyVariables);
+                }
+            }
+        }
+    }
+    const double* last = blockWorkspace+blockSize*(workspace.size()-1);
+    for (int j = 0; j < n; j++)
+        result[j] = last[j];
+}
+
 #ifdef LEPTON_USE_JIT
 static double evaluateOperation(Operation* op, double* args) {
     map<string, double>* dummyVariables = NULL;
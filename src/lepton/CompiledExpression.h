@@ -117,11 +117,20 @@ public:
      * Evaluate the expression.  The values of all variables should have been set before calling this.
      */
     double evaluate() const;
+    /**
+     * Evaluate the expression for n different values of its variables.  values[i] must point to an array with
+     * the n values of the i-th variable, in the order in which getVariables() returns them, and the n results are
+     * stored in result.  Variable references and locations are ignored.  The points are processed in blocks, and
+     * each operation is applied to a whole block with loops that the compiler can vectorize.  Since it does not
+     * modify the CompiledExpression, this function can be called concurrently from several threads.
+     */
+    void evaluate(int n, const double* const* values, double* result) const;
 private:
     friend class ParsedExpression;
     CompiledExpression(const ParsedExpression& expression);
     void compileExpression(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
     int findTempIndex(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
+    void evaluateBlock(int n, const double* const* values, double* result, double* blockWorkspace) const;
     std::map<std::string, double*> variablePointers;
     std::vector<std::pair<double*, double*> > variablesToCopy;
     std::vector<std::vector<int> > arguments;
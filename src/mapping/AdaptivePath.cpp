@@ -98,6 +98,7 @@ public:
   double getLambda() { return 0.0; }
   double transformHD( const double& dist, double& df ) const ;
   void update();
+  bool isHistoryDependent()const {return true;}
 };
 
 PLUMED_REGISTER_ACTION(AdaptivePath,"ADAPTIVE_PATH")
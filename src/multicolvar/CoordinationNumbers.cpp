@@ -157,24 +157,33 @@ CoordinationNumbers::CoordinationNumbers(const ActionOptions&ao):
 
 double CoordinationNumbers::compute( const unsigned& tindex, AtomValuePack& myatoms ) const {
   // Calculate the coordination number
-  double dfunc, sw, d, raised;
-  for(unsigned i=1; i<myatoms.getNumberOfAtoms(); ++i) {
-    Vector& distance=myatoms.getPosition(i);
-    double d2;
-    if ( (d2=distance[0]*distance[0])<rcut2 &&
-         (d2+=distance[1]*distance[1])<rcut2 &&
-         (d2+=distance[2]*distance[2])<rcut2 &&
-         d2>epsilon ) {
-
-      sw = switchingFunction.calculateSqr( d2, dfunc );
+  double dfunc[SwitchingFunction::batchSize], sw[SwitchingFunction::batchSize], d, raised;
+  // Atoms within the cutoff are collected in batches, so that switching functions are computed at once
+  double d2[SwitchingFunction::batchSize];
+  unsigned index[SwitchingFunction::batchSize];
+  const unsigned natoms=myatoms.getNumberOfAtoms();
+  for(unsigned i=1; i<natoms;) {
+    unsigned n=0;
+    for(; i<natoms && n<SwitchingFunction::batchSize; ++i) {
+      Vector& distance=myatoms.getPosition(i);
+      if ( (d2[n]=distance[0]*distance[0])<rcut2 &&
+           (d2[n]+=distance[1]*distance[1])<rcut2 &&
+           (d2[n]+=distance[2]*distance[2])<rcut2 &&
+           d2[n]>epsilon ) index[n++]=i;
+    }
+
+    switchingFunction.calculateSqr( n, d2, sw, dfunc );
+
+    for(unsigned k=0; k<n; ++k) {
+      Vector& distance=myatoms.getPosition(index[k]);
       if(r_power > 0) {
-        d = sqrt(d2); raised = pow( d, r_power - 1 );
-        accumulateSymmetryFunction( 1, i, sw * raised * d,
-                                    (dfunc * d * raised + sw * r_power) * distance,
-                                    (-dfunc * d * raised - sw * r_power) * Tensor(distance, distance),
+        d = sqrt(d2[k]); raised = pow( d, r_power - 1 );
+        accumulateSymmetryFunction( 1, index[k], sw[k] * raised * d,
+                                    (dfunc[k] * d * raised + sw[k] * r_power) * distance,
+                                    (-dfunc[k] * d * raised - sw[k] * r_power) * Tensor(distance, distance),
                                     myatoms );
       } else {
-        accumulateSymmetryFunction( 1, i, sw, (dfunc)*distance, (-dfunc)*Tensor(distance,distance), myatoms );
+        accumulateSymmetryFunction( 1, index[k], sw[k], (dfunc[k])*distance, (-dfunc[k])*Tensor(distance,distance), myatoms );
       }
     }
   }
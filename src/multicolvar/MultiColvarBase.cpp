@@ -948,6 +948,14 @@ double MultiColvarBase::calculateWeight( const unsigned& current, const double&
   return 1.0;
 }
 
+bool MultiColvarBase::hasTaskCosts() const {
+  return usespecies && !isDensity() && linkcells.enabled() && linkcells.getNumberOfCells()>0;
+}
+
+double MultiColvarBase::getTaskCost( const unsigned& current ) const {
+  return 1.0 + linkcells.countNeighboringAtoms( getPositionOfAtomForLinkCells( current ) );
+}
+
 void MultiColvarBase::performTask( const unsigned& task_index, const unsigned& current, MultiValue& myvals ) const {
   AtomValuePack myatoms( myvals, this );
   // Retrieve the atom list
@@ -169,6 +169,9 @@ public:
   virtual void calculateNumericalDerivatives( ActionWithValue* a=NULL );
 /// Perform one of the tasks
   virtual void performTask( const unsigned&, const unsigned&, MultiValue& ) const ;
+/// With link cells, the cost of a task depends on the number of atoms in the neighboring cells
+  bool hasTaskCosts() const ;
+  double getTaskCost( const unsigned& current ) const ;
 /// Update the active atoms
   virtual void updateActiveAtoms( AtomValuePack& myatoms ) const ;
 /// This gets the position of an atom for the link cell setup
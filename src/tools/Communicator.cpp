@@ -181,6 +181,31 @@ void Communicator::Allgatherv(ConstData in,Data out,const int*recvcounts,const i
 #endif
 }
 
+Communicator::Request Communicator::Iallgatherv(ConstData in,Data out,const int*recvcounts,const int*displs) {
+  Request req;
+#if defined(__PLUMED_HAS_MPI)
+  plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
+  void*s=const_cast<void*>((const void*)in.pointer);
+  void*r=const_cast<void*>((const void*)out.pointer);
+  int*rc=const_cast<int*>(recvcounts);
+  int*di=const_cast<int*>(displs);
+  if(s==NULL)s=MPI_IN_PLACE;
+#if MPI_VERSION >= 3
+  MPI_Iallgatherv(s,in.size,in.type,r,rc,di,out.type,communicator,&req.r);
+#else
+  MPI_Allgatherv(s,in.size,in.type,r,rc,di,out.type,communicator);
+  req.r=MPI_REQUEST_NULL;
+#endif
+#else
+  (void) in;
+  (void) out;
+  (void) recvcounts;
+  (void) displs;
+  plumed_merror("you are trying to use an MPI function, but PLUMED has been compiled without MPI support");
+#endif
+  return req;
+}
+
 void Communicator::Allgather(ConstData in,Data out) {
 #if defined(__PLUMED_HAS_MPI)
   plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
@@ -232,6 +257,17 @@ bool Communicator::initialized() {
   else return false;
 }
 
+bool Communicator::threadSafe() {
+  if(!initialized()) return true;
+#if defined(__PLUMED_HAS_MPI)
+  int provided;
+  MPI_Query_thread(&provided);
+  return provided==MPI_THREAD_MULTIPLE;
+#else
+  return true;
+#endif
+}
+
 void Communicator::Request::wait(Status&s) {
 #ifdef __PLUMED_HAS_MPI
   plumed_massert(initialized(),"you are trying to use an MPI function, but MPI is not initialized");
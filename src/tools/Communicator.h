@@ -169,6 +169,9 @@ public:
   void Barrier()const;
 /// Tests if MPI library is initialized
   static bool initialized();
+/// Tests if MPI functions can be called at the same time by several threads,
+/// that is if MPI is not initialized or if it was initialized with MPI_THREAD_MULTIPLE
+  static bool threadSafe();
 
 /// Returns MPI_COMM_WORLD if MPI is initialized, otherwise the default communicator
   static Communicator & Get_world();
@@ -205,6 +208,16 @@ public:
     Allgatherv(ConstData(sendbuf),Data(recvbuf),recvcounts,displs);
   }
 
+/// Wrapper for MPI_Iallgatherv (data struct).
+/// Buffers should not be touched until the returned request has been waited.
+/// If the MPI library does not support non-blocking collectives (MPI < 3)
+/// a blocking MPI_Allgatherv is done and a request that is already completed is returned
+  Request Iallgatherv(ConstData in,Data out,const int*,const int*);
+/// Wrapper for MPI_Iallgatherv (pointer)
+  template <class T,class S> Request Iallgatherv(const T*sendbuf,int sendcount,S*recvbuf,const int*recvcounts,const int*displs) {
+    return Iallgatherv(ConstData(sendbuf,sendcount),Data(recvbuf,0),recvcounts,displs);
+  }
+
 /// Wrapper for MPI_Allgather (data struct)
   void Allgather(ConstData in,Data out);
 /// Wrapper for MPI_Allgatherv (pointer)
@@ -39,6 +39,8 @@
 
 namespace PLMD {
 
+const char FileBase::binaryMagic[9]="PLMDCOL1";
+
 FileBase& FileBase::link(FILE*fp) {
   plumed_massert(!this->fp,"cannot link an already open file");
   this->fp=fp;
@@ -96,6 +98,7 @@ void        FileBase::close() {
   plumed_assert(!cloned);
   eof=false;
   err=false;
+  binary=false;
   if(fp)   std::fclose(fp);
 #ifdef __PLUMED_HAS_ZLIB
   if(gzfp) gzclose(gzFile(gzfp));
@@ -114,6 +117,7 @@ FileBase::FileBase():
   eof(false),
   err(false),
   heavyFlush(false),
+  binary(false),
   enforcedSuffix_(false)
 {
 }
@@ -154,6 +158,12 @@ std::string FileBase::appendSuffix(const std::string&path,const std::string&suff
   return ret;
 }
 
+bool FileBase::isBinaryPath(const std::string&path) {
+  std::string ext=Tools::extension(path);
+  if(ext=="gz") ext=Tools::extension(path.substr(0,path.length()-3));
+  return ext=="pbin";
+}
+
 FileBase& FileBase::enforceSuffix(const std::string&suffix) {
   enforcedSuffix_=true;
   enforcedSuffix=suffix;
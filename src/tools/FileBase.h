@@ -42,6 +42,8 @@ class FileBase {
 /// Assignment operator is disabled
   FileBase& operator=(const FileBase&) = delete;
 protected:
+/// Types of the fields stored in binary files
+  enum FieldType {typeString=0,typeDouble=1,typeInt=2};
 /// Internal tool.
 /// Base for IFile::Field and OFile::Field
   class FieldBase {
@@ -50,8 +52,15 @@ protected:
     std::string name;
     std::string value;
     bool constant;
-    FieldBase(): constant(false) {}
+/// Type of the field. In text files all fields are strings,
+/// in binary files numbers are stored in dvalue and ivalue
+    FieldType type;
+    double dvalue;
+    int ivalue;
+    FieldBase(): constant(false), type(typeString), dvalue(0.0), ivalue(0) {}
   };
+/// Tag found at the beginning of binary files
+  static const char binaryMagic[9];
 
 /// file pointer
   FILE* fp;
@@ -79,11 +88,16 @@ protected:
   std::string mode;
 /// Set to true if you want flush to be heavy (close/reopen)
   bool heavyFlush;
+/// Set to true if the file is in binary columnar format
+  bool binary;
 public:
 /// Append suffix.
 /// It appends the desired suffix to the string. Notice that
 /// it conserves some suffix (e.g. gz/xtc/trr).
   static std::string appendSuffix(const std::string&path,const std::string&suffix);
+/// Check if a path should be written in binary columnar format.
+/// This is true if its extension is pbin, possibly followed by gz.
+  static bool isBinaryPath(const std::string&path);
 private:
 /// Enforced suffix:
   std::string enforcedSuffix;
@@ -107,7 +121,7 @@ public:
   virtual FileBase& flush();
 /// Closes the file
 /// Should be used only for explicitely opened files.
-  void        close();
+  virtual void close();
 /// Virtual destructor (allows inheritance)
   virtual ~FileBase();
 /// Check for error/eof.
@@ -120,6 +134,8 @@ public:
   bool FileExist(const std::string& path);
 /// Check if a file is open
   bool isOpen();
+/// Check if the file is in binary columnar format
+  bool isBinary()const;
 /// Retrieve the path
   std::string getPath()const;
 /// Retrieve the mode
@@ -138,6 +154,11 @@ std::string FileBase::getMode()const {
   return mode;
 }
 
+inline
+bool FileBase::isBinary()const {
+  return binary;
+}
+
 
 
 }
@@ -35,6 +35,8 @@
 #include <sstream>
 #include <cstdio>
 #include <cfloat>
+#include <cstdint>
+#include <algorithm>
 
 using namespace std;
 namespace PLMD {
@@ -411,6 +413,13 @@ double Grid::getValue(const vector<unsigned> & indices) const {
 }
 
 double Grid::getValue(const vector<double> & x) const {
+  plumed_dbg_assert(x.size()==dimension_);
+  switch(dimension_) {
+  case 1: return getValueAndDerivativesN<1>(&x[0],NULL);
+  case 2: return getValueAndDerivativesN<2>(&x[0],NULL);
+  case 3: return getValueAndDerivativesN<3>(&x[0],NULL);
+  case 4: return getValueAndDerivativesN<4>(&x[0],NULL);
+  }
   if(!dospline_) {
     return getValue(getIndex(x));
   } else {
@@ -431,10 +440,121 @@ double Grid::getValueAndDerivatives
   return getValueAndDerivatives(getIndex(indices),der);
 }
 
+double Grid::getValueAndDerivativesAt(index_t index, double* der) const {
+  plumed_dbg_assert(index<maxsize_ && usederiv_);
+  for(unsigned i=0; i<dimension_; ++i) der[i]=der_[index][i];
+  return grid_[index];
+}
+
+// this is the same algorithm used in getValueAndDerivatives(const vector<double>&,vector<double>&),
+// with indexes computed inline and all the temporary arrays allocated on the stack
+template<unsigned N>
+double Grid::getValueAndDerivativesN(const double* x, double* der) const {
+  unsigned indices[N];
+  for(unsigned j=0; j<N; ++j) {
+    double f=floor((x[j]-min_[j])/dx_[j]);
+// outside the grid: the check is done before converting to unsigned, which is undefined
+// for negative numbers and NaN, and getIndex() reports the error on an invalid index
+    if(!(f>=0.0 && f<nbin_[j])) {
+      vector<unsigned> wrong(N,0);
+      wrong[j]=nbin_[j];
+      getIndex(wrong);
+    }
+    indices[j]=unsigned(f);
+  }
+
+  if(!dospline_) {
+    index_t index=indices[N-1];
+    for(unsigned i=N-1; i>0; --i) index=index*nbin_[i-1]+indices[i-1];
+    if(der) return getValueAndDerivativesAt(index,der);
+    else return getValue(index);
+  }
+
+  plumed_dbg_assert(usederiv_);
+  double xfloor[N],dder[N],C[N],D[N],tmpder[N];
+  if(!der) der=tmpder;
+  for(unsigned j=0; j<N; ++j) {
+    xfloor[j]=min_[j]+(double)(indices[j])*dx_[j];
+    der[j]=0.0;
+  }
+  double value=0.0;
+
+// loop over neighbors
+  for(unsigned ipoint=0; ipoint<(1u<<N); ++ipoint) {
+    unsigned nindices[N];
+    unsigned tmp=ipoint;
+    bool outside=false;
+    for(unsigned j=0; j<N; ++j) {
+      unsigned i0=tmp%2+indices[j];
+      tmp/=2;
+      if(i0==nbin_[j]) {
+        if(!pbc_[j]) {outside=true; break;}
+        i0=0;
+      }
+      nindices[j]=i0;
+    }
+    if(outside) continue;
+    index_t index=nindices[N-1];
+    for(unsigned i=N-1; i>0; --i) index=index*nbin_[i-1]+nindices[i-1];
+
+    double grid=getValueAndDerivativesAt(index,dder);
+    double ff=1.0;
+    for(unsigned j=0; j<N; ++j) {
+      int x0=1;
+      if(nindices[j]==indices[j]) x0=0;
+      double dx=dx_[j];
+      double X=fabs((x[j]-xfloor[j])/dx-(double)x0);
+      double X2=X*X;
+      double X3=X2*X;
+      double yy;
+      if(fabs(grid)<0.0000001) yy=0.0;
+      else yy=-dder[j]/grid;
+      C[j]=(1.0-3.0*X2+2.0*X3) - (x0?-1.0:1.0)*yy*(X-2.0*X2+X3)*dx;
+      D[j]=( -6.0*X +6.0*X2) - (x0?-1.0:1.0)*yy*(1.0-4.0*X +3.0*X2)*dx;
+      D[j]*=(x0?-1.0:1.0)/dx;
+      ff*=C[j];
+    }
+    value+=grid*ff;
+    for(unsigned j=0; j<N; ++j) {
+      double fd=D[j];
+      for(unsigned i=0; i<N; ++i) if(i!=j) fd*=C[i];
+      der[j]+=grid*fd;
+    }
+  }
+  return value;
+}
+
+void Grid::getValuesAndDerivatives(unsigned npoints, const double* x, double* values, double* der) const {
+  for(unsigned k=0; k<npoints; ++k) {
+    const double* xk=x+k*dimension_;
+    double* derk=(der?der+k*dimension_:NULL);
+    switch(dimension_) {
+    case 1: values[k]=getValueAndDerivativesN<1>(xk,derk); break;
+    case 2: values[k]=getValueAndDerivativesN<2>(xk,derk); break;
+    case 3: values[k]=getValueAndDerivativesN<3>(xk,derk); break;
+    case 4: values[k]=getValueAndDerivativesN<4>(xk,derk); break;
+    default:
+      vector<double> xx(xk,xk+dimension_);
+      if(derk) {
+        vector<double> dd(dimension_);
+        values[k]=getValueAndDerivatives(xx,dd);
+        for(unsigned j=0; j<dimension_; ++j) derk[j]=dd[j];
+      } else values[k]=getValue(xx);
+    }
+  }
+}
+
 double Grid::getValueAndDerivatives
 (const vector<double> & x, vector<double>& der) const {
   plumed_dbg_assert(der.size()==dimension_ && usederiv_);
 
+  switch(dimension_) {
+  case 1: return getValueAndDerivativesN<1>(&x[0],&der[0]);
+  case 2: return getValueAndDerivativesN<2>(&x[0],&der[0]);
+  case 3: return getValueAndDerivativesN<3>(&x[0],&der[0]);
+  case 4: return getValueAndDerivativesN<4>(&x[0],&der[0]);
+  }
+
   if(dospline_) {
     double X,X2,X3,value;
     vector<double> fd(dimension_);
@@ -597,6 +717,67 @@ void Grid::writeToFile(OFile& ofile) {
   }
 }
 
+// binary format: dimension and boundaries, followed by the number of points
+// and, for each point, its index, value and (optionally) derivatives
+static void writeBinaryHeader(std::ostream& os,unsigned dimension,bool usederiv,const vector<unsigned>& nbin,
+                              const vector<double>& min,const vector<double>& max,uint64_t npoints) {
+  uint32_t dim=dimension, der=usederiv;
+  os.write(reinterpret_cast<const char*>(&dim),sizeof(dim));
+  os.write(reinterpret_cast<const char*>(&der),sizeof(der));
+  for(unsigned i=0; i<dimension; ++i) {
+    uint32_t n=nbin[i];
+    os.write(reinterpret_cast<const char*>(&n),sizeof(n));
+    os.write(reinterpret_cast<const char*>(&min[i]),sizeof(double));
+    os.write(reinterpret_cast<const char*>(&max[i]),sizeof(double));
+  }
+  os.write(reinterpret_cast<const char*>(&npoints),sizeof(npoints));
+}
+
+void Grid::writeBinary(std::ostream& os) {
+  writeBinaryHeader(os,dimension_,usederiv_,nbin_,min_,max_,getSize());
+  vector<double> der(dimension_);
+  for(index_t i=0; i<getSize(); ++i) {
+    uint64_t index=i;
+    double f;
+    if(usederiv_) f=getValueAndDerivatives(i,der);
+    else f=getValue(i);
+    os.write(reinterpret_cast<const char*>(&index),sizeof(index));
+    os.write(reinterpret_cast<const char*>(&f),sizeof(f));
+    if(usederiv_) os.write(reinterpret_cast<const char*>(&der[0]),dimension_*sizeof(double));
+  }
+}
+
+bool Grid::readBinary(std::istream& is) {
+  uint32_t dim=0, der=0;
+  is.read(reinterpret_cast<char*>(&dim),sizeof(dim));
+  is.read(reinterpret_cast<char*>(&der),sizeof(der));
+  if(!is || dim!=dimension_ || (der!=0)!=usederiv_) return false;
+  for(unsigned i=0; i<dimension_; ++i) {
+    uint32_t n=0;
+    double min=0.0,max=0.0;
+    is.read(reinterpret_cast<char*>(&n),sizeof(n));
+    is.read(reinterpret_cast<char*>(&min),sizeof(min));
+    is.read(reinterpret_cast<char*>(&max),sizeof(max));
+    if(!is || n!=nbin_[i] || std::abs(min-min_[i])>1e-8*dx_[i] || std::abs(max-max_[i])>1e-8*dx_[i]) return false;
+  }
+  uint64_t npoints=0;
+  is.read(reinterpret_cast<char*>(&npoints),sizeof(npoints));
+  if(!is) return false;
+  clear();
+  vector<double> vder(dimension_);
+  for(uint64_t k=0; k<npoints; ++k) {
+    uint64_t index=0;
+    double f=0.0;
+    is.read(reinterpret_cast<char*>(&index),sizeof(index));
+    is.read(reinterpret_cast<char*>(&f),sizeof(f));
+    if(usederiv_) is.read(reinterpret_cast<char*>(&vder[0]),dimension_*sizeof(double));
+    if(!is || index>=maxsize_) return false;
+    if(usederiv_) setValueAndDerivatives(index,f,vder);
+    else setValue(index,f);
+  }
+  return true;
+}
+
 void Grid::writeCubeFile(OFile& ofile, const double& lunit) {
   plumed_assert( dimension_==3 );
   ofile.printf("PLUMED CUBE FILE\n");
@@ -696,19 +877,73 @@ std::unique_ptr<Grid> Grid::create(const std::string& funcl, const std::vector<V
   return grid;
 }
 
-// Sparse version of grid with map
+// Sparse version of grid with hash table
+Grid::index_t SparseGrid::hash(index_t index)const {
+  uint64_t h=static_cast<uint64_t>(index)*0x9E3779B97F4A7C15ULL;
+  h^=(h>>32);
+  return h&(table_.size()-1);
+}
+
+Grid::index_t SparseGrid::find(index_t index)const {
+  if(table_.empty()) return points_.size();
+  const index_t mask=table_.size()-1;
+  for(index_t i=hash(index);; i=(i+1)&mask) {
+    if(table_[i].second==0) return points_.size();
+    if(table_[i].first==index) return table_[i].second-1;
+  }
+}
+
+Grid::index_t SparseGrid::findOrInsert(index_t index) {
+  index_t pos=find(index);
+  if(pos<points_.size()) return pos;
+// grow the table so as to keep at least half of the slots empty
+  if(2*(points_.size()+1)>table_.size()) {
+    index_t size=(table_.empty()?16:2*table_.size());
+    table_.assign(size,std::pair<index_t,index_t>(0,0));
+    for(index_t p=0; p<points_.size(); p++) {
+      index_t i=hash(points_[p]);
+      while(table_[i].second!=0) i=(i+1)&(size-1);
+      table_[i]=std::pair<index_t,index_t>(points_[p],p+1);
+    }
+  }
+  index_t i=hash(index);
+  while(table_[i].second!=0) i=(i+1)&(table_.size()-1);
+  points_.push_back(index);
+  table_[i]=std::pair<index_t,index_t>(index,points_.size());
+  data_.resize(data_.size()+stride_,0.0);
+  return points_.size()-1;
+}
+
+std::vector<Grid::index_t> SparseGrid::getSortedPositions()const {
+  std::vector<index_t> pos(points_.size());
+  for(index_t p=0; p<pos.size(); p++) pos[p]=p;
+  std::sort(pos.begin(),pos.end(),[this](index_t a,index_t b) {return points_[a]<points_[b];});
+  return pos;
+}
+
 void SparseGrid::clear() {
-  map_.clear();
+  points_.clear();
+  data_.clear();
+  table_.clear();
 }
 
 Grid::index_t SparseGrid::getSize() const {
-  return map_.size();
+  return points_.size();
 }
 
 Grid::index_t SparseGrid::getMaxSize() const {
   return maxsize_;
 }
 
+void SparseGrid::writeBinary(std::ostream& os) {
+  writeBinaryHeader(os,dimension_,usederiv_,nbin_,min_,max_,points_.size());
+  for(const auto & p : getSortedPositions()) {
+    uint64_t index=points_[p];
+    os.write(reinterpret_cast<const char*>(&index),sizeof(index));
+    os.write(reinterpret_cast<const char*>(&data_[p*stride_]),stride_*sizeof(double));
+  }
+}
+
 double Grid::getDifferenceFromContour( const std::vector<double>& x, std::vector<double>& der ) const {
   return getValueAndDerivatives( x, der ) - contour_location;
 }
@@ -759,8 +994,21 @@ void Grid::findSetOfPointsOnContour(const double& target, const std::vector<bool
 double SparseGrid::getValue(index_t index)const {
   plumed_assert(index<maxsize_);
   double value=0.0;
-  const auto it=map_.find(index);
-  if(it!=map_.end()) value=it->second;
+  const index_t p=find(index);
+  if(p<points_.size()) value=data_[p*stride_];
+  return value;
+}
+
+double SparseGrid::getValueAndDerivativesAt(index_t index, double* der)const {
+  plumed_dbg_assert(index<maxsize_ && usederiv_);
+  double value=0.0;
+  for(unsigned int i=0; i<dimension_; ++i) der[i]=0.0;
+  const index_t p=find(index);
+  if(p<points_.size()) {
+    const double*d=&data_[p*stride_];
+    value=d[0];
+    for(unsigned int i=0; i<dimension_; ++i) der[i]=d[1+i];
+  }
   return value;
 }
 
@@ -769,36 +1017,39 @@ double SparseGrid::getValueAndDerivatives
   plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
   double value=0.0;
   for(unsigned int i=0; i<dimension_; ++i) der[i]=0.0;
-  const auto it=map_.find(index);
-  if(it!=map_.end()) value=it->second;
-  const auto itder=der_.find(index);
-  if(itder!=der_.end()) der=itder->second;
+  const index_t p=find(index);
+  if(p<points_.size()) {
+    const double*d=&data_[p*stride_];
+    value=d[0];
+    for(unsigned int i=0; i<dimension_; ++i) der[i]=d[1+i];
+  }
   return value;
 }
 
 void SparseGrid::setValue(index_t index, double value) {
   plumed_assert(index<maxsize_ && !usederiv_);
-  map_[index]=value;
+  data_[findOrInsert(index)]=value;
 }
 
 void SparseGrid::setValueAndDerivatives
 (index_t index, double value, vector<double>& der) {
   plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
-  map_[index]=value;
-  der_[index]=der;
+  double*d=&data_[findOrInsert(index)*stride_];
+  d[0]=value;
+  for(unsigned int i=0; i<dimension_; ++i) d[1+i]=der[i];
 }
 
 void SparseGrid::addValue(index_t index, double value) {
   plumed_assert(index<maxsize_ && !usederiv_);
-  map_[index]+=value;
+  data_[findOrInsert(index)]+=value;
 }
 
 void SparseGrid::addValueAndDerivatives
 (index_t index, double value, vector<double>& der) {
   plumed_assert(index<maxsize_ && usederiv_ && der.size()==dimension_);
-  map_[index]+=value;
-  der_[index].resize(dimension_);
-  for(unsigned int i=0; i<dimension_; ++i) der_[index][i]+=der[i];
+  double*d=&data_[findOrInsert(index)*stride_];
+  d[0]+=value;
+  for(unsigned int i=0; i<dimension_; ++i) d[1+i]+=der[i];
 }
 
 void SparseGrid::writeToFile(OFile& ofile) {
@@ -807,11 +1058,11 @@ void SparseGrid::writeToFile(OFile& ofile) {
   double f;
   writeHeader(ofile);
   ofile.fmtField(" "+fmt_);
-  for(const auto & it : map_) {
-    index_t i=it.first;
+  for(const auto & p : getSortedPositions()) {
+    index_t i=points_[p];
     xx=getPoint(i);
-    if(usederiv_) {f=getValueAndDerivatives(i,der);}
-    else {f=getValue(i);}
+    f=data_[p*stride_];
+    if(usederiv_) for(unsigned j=0; j<dimension_; ++j) der[j]=data_[p*stride_+1+j];
     if(i>0 && dimension_>1 && getIndices(i)[dimension_-2]==0) ofile.printf("\n");
     for(unsigned j=0; j<dimension_; ++j) {
       ofile.printField("min_" + argnames[j], str_min_[j] );
@@ -27,6 +27,7 @@
 #include <map>
 #include <cmath>
 #include <memory>
+#include <iosfwd>
 
 namespace PLMD {
 
@@ -94,6 +95,12 @@ protected:
   std::string fmt_; // format for output
 /// get "neighbors" for spline
   std::vector<index_t> getSplineNeighbors(const std::vector<unsigned> & indices)const;
+/// get value and derivatives of a grid point without allocating memory
+/// (der should point to an array with dimension_ elements)
+  virtual double getValueAndDerivativesAt(index_t index, double* der) const;
+/// get value and derivatives (if der is not NULL) in a point,
+/// implementation specialized for grids of dimension N
+  template<unsigned N> double getValueAndDerivativesN(const double* x, double* der) const;
 
 
 public:
@@ -175,6 +182,10 @@ public:
   virtual double getValueAndDerivatives(index_t index, std::vector<double>& der) const ;
   virtual double getValueAndDerivatives(const std::vector<unsigned> & indices, std::vector<double>& der) const;
   virtual double getValueAndDerivatives(const std::vector<double> & x, std::vector<double>& der) const;
+/// get values and derivatives in npoints points at once.
+/// x contains npoints*dimension coordinates, values is filled with npoints values and, if not NULL,
+/// der with npoints*dimension derivatives. No memory is allocated for grids with dimension up to four
+  void getValuesAndDerivatives(unsigned npoints, const double* x, double* values, double* der) const;
 /// Get the difference from the contour
   double getDifferenceFromContour(const std::vector<double> & x, std::vector<double>& der) const ;
 /// Find a set of points on a contour in the function
@@ -205,6 +216,11 @@ public:
 
 /// dump grid on file
   virtual void writeToFile(OFile&);
+/// dump values and derivatives on a binary stream
+  virtual void writeBinary(std::ostream&);
+/// read values and derivatives from a binary stream written with writeBinary().
+/// Returns false if the stream is not compatible with this grid
+  bool readBinary(std::istream&);
 /// dump grid to gaussian cube file
   void writeCubeFile(OFile&, const double& lunit);
 
@@ -230,18 +246,35 @@ public:
 
 class SparseGrid : public Grid
 {
-
-  std::map<index_t,double> map_;
-  std::map< index_t,std::vector<double> > der_;
+/// Grid indexes of the stored points, in order of insertion
+  std::vector<index_t> points_;
+/// Values of the stored points, each one immediately followed by its derivatives (if used)
+  std::vector<double> data_;
+/// Number of doubles stored for each point
+  unsigned stride_;
+/// Open addressing hash table with linear probing.
+/// Each slot contains a grid index and one plus its position in points_ (zero for empty slots).
+/// The size is always a power of two and at most half of the slots are occupied.
+  std::vector<std::pair<index_t,index_t> > table_;
+/// First slot where a grid index is searched
+  index_t hash(index_t index)const;
+/// Position in points_ of a grid index, or points_.size() if the point is not stored
+  index_t find(index_t index)const;
+/// Position in points_ of a grid index, storing the point with zero value and derivatives if needed
+  index_t findOrInsert(index_t index);
+/// Positions in points_ sorted by grid index, used when writing
+  std::vector<index_t> getSortedPositions()const;
 
 protected:
   void clear();
+  double getValueAndDerivativesAt(index_t index, double* der) const;
 
 public:
   SparseGrid(const std::string& funcl, const std::vector<Value*> & args, const std::vector<std::string> & gmin,
              const std::vector<std::string> & gmax,
              const std::vector<unsigned> & nbin, bool dospline, bool usederiv):
-    Grid(funcl,args,gmin,gmax,nbin,dospline,usederiv,false) {}
+    Grid(funcl,args,gmin,gmax,nbin,dospline,usederiv,false),
+    stride_(usederiv?1+args.size():1) {}
 
   index_t getSize() const;
   index_t getMaxSize() const;
@@ -270,6 +303,8 @@ public:
 
 /// dump grid on file
   void writeToFile(OFile&);
+/// dump stored values and derivatives on a binary stream
+  void writeBinary(std::ostream&);
 
   virtual ~SparseGrid() {}
 };
@@ -29,6 +29,12 @@
 #include <cstdarg>
 #include <cstring>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
 
 #include <iostream>
 #include <string>
@@ -38,6 +44,34 @@
 
 namespace PLMD {
 
+/// Size of the blocks read from text files
+static const size_t blockSize=1<<16;
+
+/// Convert a string to a double with strtod().
+/// Returns false, leaving x unchanged, for anything which is not a plain number
+/// (e.g. pi or expressions), which should be then converted with Tools::convert()
+static bool fastConvert(const std::string&str,double&x) {
+  if(str.empty() || str.find_first_not_of("0123456789+-.eE")!=std::string::npos) return false;
+  char* end;
+  errno=0;
+  double v=std::strtod(str.c_str(),&end);
+  if(errno!=0 || *end!='\0') return false;
+  x=v;
+  return true;
+}
+
+/// Convert a string to an int with strtol().
+/// Returns false, leaving x unchanged, for anything which is not a plain integer
+static bool fastConvert(const std::string&str,int&x) {
+  if(str.empty() || str.find_first_not_of("0123456789+-")!=std::string::npos) return false;
+  char* end;
+  errno=0;
+  long v=std::strtol(str.c_str(),&end,10);
+  if(errno!=0 || *end!='\0' || v<INT_MIN || v>INT_MAX) return false;
+  x=v;
+  return true;
+}
+
 size_t IFile::llread(char*ptr,size_t s) {
   plumed_assert(fp);
   size_t r;
@@ -46,7 +80,7 @@ size_t IFile::llread(char*ptr,size_t s) {
     int rr=gzread(gzFile(gzfp),ptr,s);
     if(rr==0)   eof=true;
     if(rr<0)    err=true;
-    r=rr;
+    r=(rr>0?rr:0);
 #else
     plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
 #endif
@@ -58,37 +92,213 @@ size_t IFile::llread(char*ptr,size_t s) {
   return r;
 }
 
+bool IFile::readBinary(void*ptr,size_t n) {
+// data are taken from the buffer, and only consumed when the whole record has been read
+  while(bufferEnd-bufferBegin<recordBytes+n) if(!fillBuffer()) return false;
+  if(n>0) std::memcpy(ptr,buffer.data()+bufferBegin+recordBytes,n);
+  recordBytes+=n;
+  return true;
+}
+
+bool IFile::readBinaryString(std::string&str) {
+  uint32_t len=0;
+  if(!readBinary(&len,sizeof(len))) return false;
+  str.resize(len);
+  return readBinary(&str[0],len);
+}
+
+bool IFile::readBinaryRecord() {
+  recordBytes=0;
+  char tag[4];
+  bool ok=readBinary(tag,4);
+  if(ok && !std::strncmp(tag,binaryMagic,4)) {
+    char version[4];
+    int32_t one=0;
+    ok=readBinary(version,4) && readBinary(&one,sizeof(one));
+    if(ok) {
+      plumed_massert(!std::strncmp(version,binaryMagic+4,4),"file " + getPath() + ": unsupported version of the binary format");
+      plumed_massert(one==1,"file " + getPath() + ": binary file written on a machine with different endianness");
+    }
+  } else if(ok && !std::strncmp(tag,"HEAD",4)) {
+// the record is stored in temporaries, so that nothing changes if it is incomplete
+    std::vector<Field> newfields;
+    uint32_t n=0,nconst=0;
+    ok=readBinary(&n,sizeof(n));
+    for(unsigned i=0; ok && i<n; i++) {
+      Field field;
+      int32_t type=0;
+      ok=readBinary(&type,sizeof(type)) && readBinaryString(field.name);
+      if(ok) plumed_massert(type==typeString || type==typeDouble || type==typeInt,"file " + getPath() + ": corrupted binary file");
+      field.type=FieldType(type);
+      newfields.push_back(field);
+    }
+    ok=ok && readBinary(&nconst,sizeof(nconst));
+    for(unsigned i=0; ok && i<nconst; i++) {
+      Field field;
+      ok=readBinaryString(field.name) && readBinaryString(field.value);
+      field.constant=true;
+      newfields.push_back(field);
+    }
+    if(ok) {
+      fields=newfields;
+      columns.assign(n,std::vector<char>());
+      columnPos.assign(n,0);
+      blockRows=0;
+      blockRow=0;
+    }
+  } else if(ok && !std::strncmp(tag,"BLCK",4)) {
+    uint32_t nrows=0,ncols=0;
+    ok=readBinary(&nrows,sizeof(nrows)) && readBinary(&ncols,sizeof(ncols));
+    std::vector<std::vector<char> > newcolumns(ok?ncols:0);
+    for(unsigned i=0; ok && i<ncols; i++) {
+      uint64_t size=0;
+      ok=readBinary(&size,sizeof(size));
+      if(ok) newcolumns[i].resize(size);
+      ok=ok && readBinary(newcolumns[i].data(),size);
+    }
+    if(ok) {
+      plumed_massert(ncols==columns.size(),"file " + getPath() + ": mismatch between number of fields in file and expected number");
+      columns.swap(newcolumns);
+      columnPos.assign(ncols,0);
+      blockRows=nrows;
+      blockRow=0;
+    }
+  } else if(ok && !std::strncmp(tag,"TEXT",4)) {
+    std::string line;
+    ok=readBinaryString(line);
+  } else if(ok) {
+    plumed_merror("file " + getPath() + ": corrupted binary file");
+  }
+// as in getline(), an incomplete record is kept in the buffer and read again after reset()
+  if(ok) bufferBegin+=recordBytes;
+  else eof=true;
+  return ok;
+}
+
+IFile& IFile::advanceBinaryField() {
+  plumed_assert(!inMiddleOfField);
+  while(blockRow>=blockRows) if(!readBinaryRecord()) return *this;
+  unsigned j=0;
+  for(unsigned i=0; i<fields.size(); i++) {
+    Field & field(fields[i]);
+    if(field.constant) continue;
+    const std::vector<char> & column(columns[j]);
+    size_t & p(columnPos[j]);
+    if(field.type==typeDouble) {
+      plumed_massert(p+sizeof(double)<=column.size(),"file " + getPath() + ": corrupted binary file");
+      std::memcpy(&field.dvalue,&column[p],sizeof(double));
+      p+=sizeof(double);
+    } else if(field.type==typeInt) {
+      int32_t v;
+      plumed_massert(p+sizeof(v)<=column.size(),"file " + getPath() + ": corrupted binary file");
+      std::memcpy(&v,&column[p],sizeof(v));
+      field.ivalue=v;
+      p+=sizeof(v);
+    } else {
+      uint32_t len;
+      plumed_massert(p+sizeof(len)<=column.size(),"file " + getPath() + ": corrupted binary file");
+      std::memcpy(&len,&column[p],sizeof(len));
+      p+=sizeof(len);
+      plumed_massert(p+len<=column.size(),"file " + getPath() + ": corrupted binary file");
+      field.value.assign(&column[p],len);
+      p+=len;
+    }
+    field.read=false;
+    j++;
+  }
+  blockRow++;
+  inMiddleOfField=true;
+  return *this;
+}
+
+void IFile::readHeaderLine(const std::string&line) {
+// header lines are rare, they can be parsed with Tools::getWords()
+  std::vector<std::string> words=Tools::getWords(line);
+  if(words.size()>=2 && words[0]=="#!" && words[1]=="FIELDS") {
+    fields.clear();
+    for(unsigned i=2; i<words.size(); i++) {
+      Field field;
+      field.name=words[i];
+      fields.push_back(field);
+    }
+  } else if(words.size()==4 && words[0]=="#!" && words[1]=="SET") {
+    Field field;
+    field.name=words[2];
+    field.value=words[3];
+    field.constant=true;
+    fields.push_back(field);
+  }
+}
+
+uint64_t IFile::skipFields(uint64_t n) {
+  plumed_assert(!inMiddleOfField);
+  uint64_t nskip=0;
+  if(binary) {
+    while(nskip<n) {
+      if(blockRow>=blockRows) {
+        if(!readBinaryRecord()) break;
+      } else if(n-nskip>=blockRows-blockRow) {
+// whole blocks are skipped without looking at their values
+        nskip+=blockRows-blockRow;
+        blockRow=blockRows;
+      } else {
+        advanceBinaryField();
+        inMiddleOfField=false;
+        nskip++;
+      }
+    }
+    return nskip;
+  }
+  while(nskip<n) {
+    getline(line);
+    if(!*this) break;
+    const size_t first=line.find_first_not_of(" \t");
+    if(first==std::string::npos) continue;
+    if(line.compare(first,2,"#!")==0) readHeaderLine(line);
+// lines containing only a comment are not counted, as in advanceField()
+    else if(line[first]!='#') nskip++;
+  }
+  return nskip;
+}
+
 IFile& IFile::advanceField() {
+  if(binary) return advanceBinaryField();
   plumed_assert(!inMiddleOfField);
-  std::string line;
   bool done=false;
   while(!done) {
     getline(line);
     if(!*this) {return *this;}
-    std::vector<std::string> words=Tools::getWords(line);
-    if(words.size()>=2 && words[0]=="#!" && words[1]=="FIELDS") {
-      fields.clear();
-      for(unsigned i=2; i<words.size(); i++) {
-        Field field;
-        field.name=words[i];
-        fields.push_back(field);
-      }
-    } else if(words.size()==4 && words[0]=="#!" && words[1]=="SET") {
-      Field field;
-      field.name=words[2];
-      field.value=words[3];
-      field.constant=true;
-      fields.push_back(field);
+    const size_t first=line.find_first_not_of(" \t");
+    if(first!=std::string::npos && line.compare(first,2,"#!")==0) {
+      readHeaderLine(line);
     } else {
       unsigned nf=0;
       for(unsigned i=0; i<fields.size(); i++) if(!fields[i].constant) nf++;
-      Tools::trimComments(line);
-      words=Tools::getWords(line);
+// comments start at the first #
+      const size_t end=std::min(line.find('#'),line.length());
+// words are found in place, and only copied in the values of the fields
+      std::vector<std::string> parWords;
+      words.clear();
+      if(line.find_first_of("{}")<end) {
+        parWords=Tools::getWords(line.substr(0,end));
+        for(const auto & w : parWords) words.push_back(std::make_pair(w.c_str(),w.length()));
+      } else {
+        const char* p=line.c_str();
+        size_t i=0;
+        while(true) {
+          while(i<end && (p[i]==' ' || p[i]=='\t' || p[i]=='\n')) i++;
+          if(i>=end) break;
+          size_t j=i;
+          while(j<end && p[j]!=' ' && p[j]!='\t' && p[j]!='\n') j++;
+          words.push_back(std::make_pair(p+i,j-i));
+          i=j;
+        }
+      }
       if( words.size()==nf ) {
         unsigned j=0;
         for(unsigned i=0; i<fields.size(); i++) {
           if(fields[i].constant) continue;
-          fields[i].value=words[j];
+          fields[i].value.assign(words[j].first,words[j].second);
           fields[i].read=false;
           j++;
         }
@@ -118,6 +328,24 @@ IFile& IFile::open(const std::string&path) {
     plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
 #endif
   }
+  binary=isBinaryPath(path) || isBinaryPath(this->path);
+  if(!binary) {
+// binary files are also recognized from their first bytes
+    char magic[8];
+    if(llread(magic,8)==8 && !std::strncmp(magic,binaryMagic,8)) binary=true;
+#ifdef __PLUMED_HAS_ZLIB
+    if(gzfp) gzrewind(gzFile(gzfp));
+#endif
+    if(!gzfp) std::rewind(fp);
+    eof=false;
+    err=false;
+  }
+  columns.clear();
+  columnPos.clear();
+  blockRows=0;
+  blockRow=0;
+  bufferBegin=0;
+  bufferEnd=0;
   if(plumed) plumed->insertFile(*this);
   return *this;
 }
@@ -143,22 +371,46 @@ IFile& IFile::scanField(const std::string&name,std::string&str) {
   if(!inMiddleOfField) advanceField();
   if(!*this) return *this;
   unsigned i=findField(name);
-  str=fields[i].value;
+  if(fields[i].type==typeDouble) {
+    char buf[32];
+    std::snprintf(buf,sizeof(buf),"%.17g",fields[i].dvalue);
+    str=buf;
+  } else if(fields[i].type==typeInt) {
+    Tools::convert(fields[i].ivalue,str);
+  } else {
+    str=fields[i].value;
+  }
   fields[i].read=true;
   return *this;
 }
 
 IFile& IFile::scanField(const std::string&name,double &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
+  if(!inMiddleOfField) advanceField();
+  if(!*this) return *this;
+  Field & field(fields[findField(name)]);
+  field.read=true;
+// numbers read from binary files are not converted
+  if(field.type==typeDouble) x=field.dvalue;
+  else if(field.type==typeInt) x=field.ivalue;
+  else if(!fastConvert(field.value,x)) Tools::convert(field.value,x);
   return *this;
 }
 
 IFile& IFile::scanField(const std::string&name,int &x) {
-  std::string str;
-  scanField(name,str);
-  if(*this) Tools::convert(str,x);
+  if(!inMiddleOfField) advanceField();
+  if(!*this) return *this;
+  Field & field(fields[findField(name)]);
+  if(field.type==typeInt) {
+    field.read=true;
+    x=field.ivalue;
+  } else if(field.type==typeString) {
+    field.read=true;
+    if(!fastConvert(field.value,x)) Tools::convert(field.value,x);
+  } else {
+    std::string str;
+    scanField(name,str);
+    Tools::convert(str,x);
+  }
   return *this;
 }
 
@@ -190,7 +442,12 @@ IFile& IFile::scanField() {
 IFile::IFile():
   inMiddleOfField(false),
   ignoreFields(false),
-  noEOL(false)
+  noEOL(false),
+  bufferBegin(0),
+  bufferEnd(0),
+  recordBytes(0),
+  blockRows(0),
+  blockRow(0)
 {
 }
 
@@ -198,31 +455,47 @@ IFile::~IFile() {
   if(inMiddleOfField) std::cerr<<"WARNING: IFile closed in the middle of reading. seems strange!\n";
 }
 
-IFile& IFile::getline(std::string &str) {
-  char tmp=0;
-  str="";
-  fpos_t pos;
-  fgetpos(fp,&pos);
-  while(llread(&tmp,1)==1 && tmp && tmp!='\n' && tmp!='\r' && !eof && !err) {
-    str+=tmp;
+bool IFile::fillBuffer() {
+// the bytes not yet returned are moved at the beginning of the buffer
+  if(bufferBegin>0) {
+    std::memmove(buffer.data(),buffer.data()+bufferBegin,bufferEnd-bufferBegin);
+    bufferEnd-=bufferBegin;
+    bufferBegin=0;
   }
-  if(tmp=='\r') {
-    llread(&tmp,1);
-    plumed_massert(tmp=='\n',"plumed only accepts \\n (unix) or \\r\\n (dos) new lines");
+  if(buffer.size()<blockSize) buffer.resize(blockSize);
+  else if(bufferEnd==buffer.size()) buffer.resize(2*buffer.size());
+  size_t n=llread(buffer.data()+bufferEnd,buffer.size()-bufferEnd);
+// end of file is only reported when no line can be returned
+  if(n>0) eof=false;
+  bufferEnd+=n;
+  return n>0;
+}
+
+IFile& IFile::getline(std::string &str) {
+  plumed_massert(!binary,"file " + getPath() + ": lines cannot be read from a binary file");
+  while(true) {
+    const char* begin=buffer.data()+bufferBegin;
+    const char* nl=NULL;
+    if(bufferEnd>bufferBegin) nl=static_cast<const char*>(std::memchr(begin,'\n',bufferEnd-bufferBegin));
+    if(nl) {
+      size_t len=nl-begin;
+      bufferBegin+=len+1;
+      if(len>0 && begin[len-1]=='\r') len--;
+      plumed_massert(!std::memchr(begin,'\r',len),"plumed only accepts \\n (unix) or \\r\\n (dos) new lines");
+      str.assign(begin,len);
+      return *this;
+    }
+    if(!fillBuffer()) break;
   }
-  if(eof && noEOL) {
-    if(str.length()>0) eof=false;
-  } else if(eof || err || tmp!='\n') {
+  if(eof && noEOL && bufferEnd>bufferBegin) {
+    str.assign(buffer.data()+bufferBegin,bufferEnd-bufferBegin);
+    bufferBegin=bufferEnd;
+    eof=false;
+  } else {
     eof = true;
     str="";
-    if(!err) fsetpos(fp,&pos);
-// there was a fsetpos here that apparently is not necessary
-//  fsetpos(fp,&pos);
-// I think it was necessary to have rewind working correctly
-// after end of file. Since rewind is not used now anywhere,
-// it should be ok not to reset position.
-// This is necessary so that eof works properly for emacs files
-// with no endline at end of file.
+// an incomplete line is kept in the buffer. In this way, if the file is being
+// written by another process, it can be read completely after reset(false)
   }
   return *this;
 }
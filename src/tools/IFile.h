@@ -24,6 +24,8 @@
 
 #include "FileBase.h"
 #include <vector>
+#include <utility>
+#include <cstdint>
 
 namespace PLMD {
 
@@ -36,6 +38,16 @@ Class for input files
 This class provides features similar to those in the standard C "FILE*" type,
 but only for sequential input. See OFile for sequential output.
 
+Text files are read in large blocks, which are split in lines and words without
+allocating memory for each of them. Numbers are converted with strtod()/strtol(), and
+Tools::convert() is only used for values that are not plain numbers (e.g. expressions
+containing pi).
+
+Files in the binary columnar format written by OFile are recognized from their
+extension or from their first bytes, and can be read with the same methods used
+for text files. Numbers are then returned without any conversion from text.
+getline() cannot be used on binary files.
+
 */
 class IFile:
 /// Class identifying a single field for fielded output
@@ -57,10 +69,42 @@ class IFile:
   bool ignoreFields;
 /// Set to true to allow files without end-of-line at the end
   bool noEOL;
+/// Buffer for reading the file in large blocks
+  std::vector<char> buffer;
+/// Position in buffer of the first byte not yet returned by getline() or readBinaryRecord()
+  size_t bufferBegin;
+/// Number of bytes read in buffer
+  size_t bufferEnd;
+/// Number of bytes of the record being read from a binary file, starting from bufferBegin
+  size_t recordBytes;
+/// Read more data in buffer, keeping the bytes not yet returned. Returns false if nothing could be read
+  bool fillBuffer();
+/// Last line read by advanceField()
+  std::string line;
+/// Beginning and length of the words of line
+  std::vector<std::pair<const char*,size_t> > words;
 /// Advance to next field (= read one line)
   IFile& advanceField();
+/// Update the fields according to a header line (starting with #!)
+  void readHeaderLine(const std::string&);
 /// Find field index by name
   unsigned findField(const std::string&name)const;
+/// Values of the rows of the current block of a binary file, column by column
+  std::vector<std::vector<char> > columns;
+/// Position of the next value to be read in each column
+  std::vector<size_t> columnPos;
+/// Number of rows in the current block of a binary file
+  unsigned blockRows;
+/// Number of rows of the current block already read
+  unsigned blockRow;
+/// Read n bytes of a binary file. Returns false if the file ended before
+  bool readBinary(void*,size_t n);
+/// Read a string stored in a binary file
+  bool readBinaryString(std::string&);
+/// Read the next record of a binary file. Returns false at the end of the file
+  bool readBinaryRecord();
+/// Advance to the next row of a binary file
+  IFile& advanceBinaryField();
 public:
 /// Constructor
   IFile();
@@ -87,6 +131,10 @@ public:
   IFile& scanField();
 /// Get a full line as a string
   IFile& getline(std::string&);
+/// Skip n lines of fields without converting their values.
+/// Header lines are interpreted as usual. Returns the number of lines actually skipped,
+/// which is smaller than n only if the file ended before
+  uint64_t skipFields(uint64_t n);
 /// Reset end of file
   void reset(bool);
 /// Check if a field exist
@@ -355,6 +355,39 @@ double KernelFunctions::evaluate( const std::vector<Value*>& pos, std::vector<do
     }
     for(unsigned i=0; i<sinout.size(); ++i) r2+=sintmp[i]*sinout[i];
   }
+  double kval=getValueFromR2( r2, &derivatives[0] );
+  if(doInt) {
+    if((pos[0]->get() <= lowI_ || pos[0]->get() >= uppI_) && usederiv ) for(unsigned i=0; i<ndim(); ++i)derivatives[i]=0;
+  }
+  return kval;
+}
+
+double KernelFunctions::evaluateDisplacement( const double* dist, double* derivatives ) const {
+  double r2=0;
+  if(dtype==diagonal) {
+    for(unsigned i=0; i<ndim(); ++i) {
+      derivatives[i]=dist[i] / width[i];
+      r2+=derivatives[i]*derivatives[i];
+      derivatives[i] /= width[i];
+    }
+  } else if(dtype==multi) {
+    unsigned k=0;
+    for(unsigned i=0; i<ndim(); ++i) derivatives[i]=0;
+    for(unsigned i=0; i<ndim(); ++i) {
+      // width stores the upper triangle of the metric
+      derivatives[i]+=width[k]*dist[i]; r2+=width[k]*dist[i]*dist[i]; k++;
+      for(unsigned j=i+1; j<ndim(); ++j) {
+        derivatives[i]+=width[k]*dist[j]; derivatives[j]+=width[k]*dist[i];
+        r2+=2*width[k]*dist[i]*dist[j]; k++;
+      }
+    }
+  } else {
+    plumed_merror("kernels with von misses metric cannot be evaluated from the displacement");
+  }
+  return getValueFromR2( r2, derivatives );
+}
+
+double KernelFunctions::getValueFromR2( const double& r2, double* derivatives ) const {
   double kderiv, kval;
   if(ktype==gaussian) {
     kval=height*std::exp(-0.5*r2); kderiv=-kval;
@@ -377,9 +410,6 @@ double KernelFunctions::evaluate( const std::vector<Value*>& pos, std::vector<do
     kderiv*=height / r ;
   }
   for(unsigned i=0; i<ndim(); ++i) derivatives[i]*=kderiv;
-  if(doInt) {
-    if((pos[0]->get() <= lowI_ || pos[0]->get() >= uppI_) && usederiv ) for(unsigned i=0; i<ndim(); ++i)derivatives[i]=0;
-  }
   return kval;
 }
 
@@ -46,6 +46,8 @@ private:
   void setData( const std::vector<double>& at, const std::vector<double>& sig, const std::string& type, const std::string& mtype, const double& w );
 /// Convert the width into matrix form
   Matrix<double> getMatrix() const;
+/// Get the value of the kernel from the squared scaled distance and multiply the derivatives of r2 by its derivative
+  double getValueFromR2( const double& r2, double* derivatives ) const;
 public:
   explicit KernelFunctions( const std::string& input );
   KernelFunctions( const std::vector<double>& at, const std::vector<double>& sig, const std::string& type, const std::string& mtype, const double& w );
@@ -58,12 +60,17 @@ public:
   double getCutoff( const double& width ) const ;
 /// Get the position of the center
   std::vector<double> getCenter() const;
+/// Move the center of the kernel, so that the same object can be reused for several points
+  void setCenter( const std::vector<double>& at );
 /// Get the support
   std::vector<unsigned> getSupport( const std::vector<double>& dx ) const;
 /// get it in continuous form
   std::vector<double> getContinuousSupport( ) const;
 /// Evaluate the kernel function with constant intervals
   double evaluate( const std::vector<Value*>& pos, std::vector<double>& derivatives, bool usederiv=true, bool doInt=false, double lowI_=-1, double uppI_=-1 ) const;
+/// Evaluate the kernel at a point given its displacement dist from the center, with periodicity already taken into account.
+/// Only for diagonal and multivariate metrics. The derivatives with respect to the position of the point are stored in derivatives
+  double evaluateDisplacement( const double* dist, double* derivatives ) const;
 /// Read a kernel function from a file
   static std::unique_ptr<KernelFunctions> read( IFile* ifile, const bool& cholesky, const std::vector<std::string>& valnames );
 };
@@ -90,5 +97,11 @@ std::vector<double> KernelFunctions::getCenter() const {
   return center;
 }
 
+inline
+void KernelFunctions::setCenter( const std::vector<double>& at ) {
+  plumed_dbg_assert( at.size()==center.size() );
+  for(unsigned i=0; i<center.size(); ++i) center[i]=at[i];
+}
+
 }
 #endif
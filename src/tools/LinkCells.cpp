@@ -137,6 +137,31 @@ void LinkCells::retrieveNeighboringAtoms( const Vector& pos, std::vector<unsigne
   retrieveAtomsInCells( ncellt, cell_list, natomsper, atoms );
 }
 
+unsigned LinkCells::countNeighboringAtoms( const Vector& pos ) const {
+  // At most 27 cells are needed, so they are stored in a small array
+  std::vector<unsigned> celn( findMyCell( pos ) );
+  unsigned cells[27], ncellt=0, natoms=0;
+  for(int nx=LINKC_MIN(ncells[0]); nx<LINKC_MAX(ncells[0]); ++nx) {
+    int xval = celn[0] + nx;
+    xval=LINKC_PBC(xval,ncells[0])*nstride[0];
+    for(int ny=LINKC_MIN(ncells[1]); ny<LINKC_MAX(ncells[1]); ++ny) {
+      int yval = celn[1] + ny;
+      yval=LINKC_PBC(yval,ncells[1])*nstride[1];
+      for(int nz=LINKC_MIN(ncells[2]); nz<LINKC_MAX(ncells[2]); ++nz) {
+        int zval = celn[2] + nz;
+        zval=LINKC_PBC(zval,ncells[2])*nstride[2];
+
+        unsigned mybox=xval+yval+zval; bool added=false;
+        for(unsigned k=0; k<ncellt; ++k) {
+          if( mybox==cells[k] ) { added=true; break; }
+        }
+        if( !added ) { cells[ncellt]=mybox; ncellt++; natoms+=lcell_tots[mybox]; }
+      }
+    }
+  }
+  return natoms;
+}
+
 void LinkCells::retrieveAtomsInCells( const unsigned& ncells_required,
                                       const std::vector<unsigned>& cells_required,
                                       unsigned& natomsper, std::vector<unsigned>& atoms ) const {
@@ -82,6 +82,8 @@ public:
                              unsigned& natomsper, std::vector<unsigned>& atoms ) const ;
 /// Retrieve the atoms we need to consider
   void retrieveNeighboringAtoms( const Vector& pos, std::vector<unsigned>& cell_list, unsigned& natomsper, std::vector<unsigned>& atoms ) const ;
+/// Count the atoms that retrieveNeighboringAtoms would return, without retrieving them
+  unsigned countNeighboringAtoms( const Vector& pos ) const ;
 };
 
 inline
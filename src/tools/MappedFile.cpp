@@ -0,0 +1,116 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2018 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#include "MappedFile.h"
+#include <cstdio>
+
+#ifdef __PLUMED_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace PLMD {
+
+MappedFile::~MappedFile() {
+  close();
+}
+
+bool MappedFile::open(const std::string& path) {
+  close();
+#ifdef __PLUMED_HAS_MMAP
+  int fd=::open(path.c_str(),O_RDONLY);
+  if(fd<0) return false;
+  struct stat st;
+  if(fstat(fd,&st)!=0) {
+    ::close(fd);
+    return false;
+  }
+  length=st.st_size;
+// mmap does not accept empty files
+  if(length>0) {
+    void* p=mmap(NULL,length,PROT_READ,MAP_SHARED,fd,0);
+    if(p==MAP_FAILED) {
+      ::close(fd);
+      length=0;
+      return false;
+    }
+    data=static_cast<const char*>(p);
+    mapped=true;
+  }
+// the mapping stays valid after the file descriptor is closed
+  ::close(fd);
+  opened=true;
+  return true;
+#else
+  FILE* fp=std::fopen(path.c_str(),"rb");
+  if(!fp) return false;
+  std::fseek(fp,0,SEEK_END);
+  long n=std::ftell(fp);
+  std::fseek(fp,0,SEEK_SET);
+  if(n<0) {
+    std::fclose(fp);
+    return false;
+  }
+  buffer.resize(n);
+  bool ok=(n==0 || std::fread(&buffer[0],1,n,fp)==size_t(n));
+  std::fclose(fp);
+  if(!ok) {
+    buffer.clear();
+    return false;
+  }
+  length=n;
+  if(n>0) data=&buffer[0];
+  opened=true;
+  return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifdef __PLUMED_HAS_MMAP
+  if(mapped) munmap(const_cast<char*>(data),length);
+#endif
+  buffer.clear();
+  data=nullptr;
+  length=0;
+  opened=false;
+  mapped=false;
+}
+
+void MappedFile::willNeed(std::size_t offset,std::size_t n)const {
+#ifdef __PLUMED_HAS_MMAP
+  if(!mapped || offset>=length) return;
+  if(offset+n>length) n=length-offset;
+// madvise needs an address aligned to the page size
+  const std::size_t page=sysconf(_SC_PAGESIZE);
+  const std::size_t start=(offset/page)*page;
+  madvise(const_cast<char*>(data)+start,offset+n-start,MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::sequential()const {
+#ifdef __PLUMED_HAS_MMAP
+  if(mapped) madvise(const_cast<char*>(data),length,MADV_SEQUENTIAL);
+#endif
+}
+
+}
@@ -0,0 +1,81 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2018 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_MappedFile_h
+#define __PLUMED_tools_MappedFile_h
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace PLMD {
+
+/**
+\ingroup TOOLBOX
+Class giving read-only access to the content of a whole file through a pointer.
+
+When PLUMED is compiled with mmap support, the file is mapped in memory
+and its pages are only loaded by the operating system when they are accessed.
+Data can thus be read in any order and without copies, which makes it possible
+to jump directly to any record of a file with fixed size records.
+Otherwise, the whole file is read in memory when it is opened.
+\verbatim
+MappedFile mf;
+if(!mf.open("traj.dcd")) plumed_merror("cannot open traj.dcd");
+const char* data=mf.getData();
+for(size_t i=0;i<mf.size();i++) ... data[i] ...
+\endverbatim
+*/
+class MappedFile {
+/// Pointer to the content of the file
+  const char* data=nullptr;
+/// Size of the file
+  std::size_t length=0;
+/// Is the file open
+  bool opened=false;
+/// Is data obtained with mmap
+  bool mapped=false;
+/// Content of the file, when it is not mapped
+  std::vector<char> buffer;
+public:
+  MappedFile() {}
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+/// Open a file. Returns false in case of error
+  bool open(const std::string& path);
+/// Release the file
+  void close();
+/// Check if the file is open
+  bool isOpen()const {return opened;}
+/// Pointer to the beginning of the file (NULL for an empty file)
+  const char* getData()const {return data;}
+/// Size of the file in bytes
+  std::size_t size()const {return length;}
+/// Tell the operating system that the bytes in [offset,offset+n) will be accessed soon
+  void willNeed(std::size_t offset,std::size_t n)const;
+/// Tell the operating system that the file is going to be accessed sequentially
+  void sequential()const;
+};
+
+}
+
+#endif
@@ -24,6 +24,9 @@
 #include "Pbc.h"
 #include "AtomNumber.h"
 #include "Tools.h"
+#include "LinkCells.h"
+#include "Communicator.h"
+#include "OpenMP.h"
 #include <vector>
 #include <algorithm>
 
@@ -34,7 +37,7 @@ NeighborList::NeighborList(const vector<AtomNumber>& list0, const vector<AtomNum
                            const bool& do_pair, const bool& do_pbc, const Pbc& pbc,
                            const double& distance, const unsigned& stride): reduced(false),
   do_pair_(do_pair), do_pbc_(do_pbc), pbc_(&pbc),
-  distance_(distance), stride_(stride)
+  distance_(distance), skin_(0.0), stride_(stride)
 {
 // store full list of atoms needed
   fullatomlist_=list0;
@@ -56,7 +59,7 @@ NeighborList::NeighborList(const vector<AtomNumber>& list0, const bool& do_pbc,
                            const Pbc& pbc, const double& distance,
                            const unsigned& stride): reduced(false),
   do_pbc_(do_pbc), pbc_(&pbc),
-  distance_(distance), stride_(stride) {
+  distance_(distance), skin_(0.0), stride_(stride) {
   fullatomlist_=list0;
   nlist0_=list0.size();
   twolists_=false;
@@ -76,6 +79,17 @@ vector<AtomNumber>& NeighborList::getFullAtomList() {
   return fullatomlist_;
 }
 
+NeighborList::~NeighborList() {
+// destructor required to delete forward declared classes
+}
+
+void NeighborList::enableLinkCells() {
+  if(!linkcells_) {
+    serialcomm_.reset( new Communicator );
+    linkcells_.reset( new LinkCells( *serialcomm_ ) );
+  }
+}
+
 pair<unsigned,unsigned> NeighborList::getIndexPair(unsigned ipair) {
   pair<unsigned,unsigned> index;
   if(twolists_ && do_pair_) {
@@ -93,9 +107,15 @@ pair<unsigned,unsigned> NeighborList::getIndexPair(unsigned ipair) {
 
 void NeighborList::update(const vector<Vector>& positions) {
   neighbors_.clear();
-  const double d2=distance_*distance_;
+  const double d2=(distance_+skin_)*(distance_+skin_);
 // check if positions array has the correct length
   plumed_assert(positions.size()==fullatomlist_.size());
+  if(skin_>0.0) positions0_=positions;
+  if(canUseLinkCells()) {
+    updateWithLinkCells(positions);
+    setRequestList();
+    return;
+  }
   for(unsigned int i=0; i<nallpairs_; ++i) {
     pair<unsigned,unsigned> index=getIndexPair(i);
     unsigned index0=index.first;
@@ -112,6 +132,51 @@ void NeighborList::update(const vector<Vector>& positions) {
   setRequestList();
 }
 
+bool NeighborList::canUseLinkCells() const {
+// link cells are useless when pairs are fixed and require a box
+  return linkcells_ && do_pbc_ && pbc_->isSet() && !(twolists_ && do_pair_);
+}
+
+void NeighborList::updateWithLinkCells(const vector<Vector>& positions) {
+  const double d2=(distance_+skin_)*(distance_+skin_);
+// with two lists only the second one is sorted in cells, and atoms
+// in the first list look for their neighbors there
+  const unsigned first=(twolists_ ? nlist0_ : 0);
+  const unsigned ncellatoms=positions.size()-first;
+  vector<Vector> cellpos(positions.begin()+first,positions.end());
+  vector<unsigned> cellind(ncellatoms);
+  for(unsigned i=0; i<ncellatoms; ++i) cellind[i]=first+i;
+  linkcells_->setCutoff(distance_+skin_);
+  linkcells_->buildCellLists(cellpos,cellind,*pbc_);
+
+  unsigned nt=OpenMP::getNumThreads();
+  if(nt*10>nlist0_) nt=nlist0_/10;
+  if(nt==0)nt=1;
+
+  #pragma omp parallel num_threads(nt)
+  {
+    vector<unsigned> cells_required(linkcells_->getNumberOfCells());
+    vector<unsigned> atoms(1+ncellatoms);
+    vector<pair<unsigned,unsigned> > omp_neighbors;
+    #pragma omp for nowait
+    for(unsigned i=0; i<nlist0_; ++i) {
+      unsigned natomsper=1; atoms[0]=i;
+      linkcells_->retrieveNeighboringAtoms(positions[i],cells_required,natomsper,atoms);
+      for(unsigned k=1; k<natomsper; ++k) {
+        unsigned j=atoms[k];
+// with a single list each pair is only counted once
+        if(!twolists_ && j<i) continue;
+        double value=modulo2(pbc_->distance(positions[i],positions[j]));
+        if(value<=d2) omp_neighbors.push_back(pair<unsigned,unsigned>(i,j));
+      }
+    }
+    #pragma omp critical
+    neighbors_.insert(neighbors_.end(),omp_neighbors.begin(),omp_neighbors.end());
+  }
+// sorting makes the list identical to the one obtained looping over all pairs
+  std::sort(neighbors_.begin(),neighbors_.end());
+}
+
 void NeighborList::setRequestList() {
   requestlist_.clear();
   for(unsigned int i=0; i<size(); ++i) {
@@ -136,6 +201,28 @@ vector<AtomNumber>& NeighborList::getReducedAtomList() {
   return requestlist_;
 }
 
+bool NeighborList::needsUpdate(const vector<Vector>& positions) const {
+  if(positions0_.size()!=positions.size()) return true;
+// same criterion as in SimpleMD: the list is safe as long as
+// no atom moved more than half of the skin thickness
+  const double delta2=0.25*skin_*skin_;
+  for(unsigned i=0; i<positions.size(); ++i) {
+    Vector displacement;
+    if(do_pbc_) displacement=pbc_->distance(positions0_[i],positions[i]);
+    else displacement=delta(positions0_[i],positions[i]);
+    if(modulo2(displacement)>delta2) return true;
+  }
+  return false;
+}
+
+void NeighborList::setSkin(const double& skin) {
+  skin_=skin;
+}
+
+double NeighborList::getSkin() const {
+  return skin_;
+}
+
 unsigned NeighborList::getStride() const {
   return stride_;
 }
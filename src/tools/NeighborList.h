@@ -26,10 +26,13 @@
 #include "AtomNumber.h"
 
 #include <vector>
+#include <memory>
 
 namespace PLMD {
 
 class Pbc;
+class Communicator;
+class LinkCells;
 
 /// \ingroup TOOLBOX
 /// A class that implements neighbor lists from two lists or a single list of atoms
@@ -41,7 +44,15 @@ class NeighborList
   std::vector<PLMD::AtomNumber> fullatomlist_,requestlist_;
   std::vector<std::pair<unsigned,unsigned> > neighbors_;
   double distance_;
+/// Skin added to the cutoff when the list is built
+  double skin_;
+/// Positions of the atoms at the last update, used to check displacements
+  std::vector<PLMD::Vector> positions0_;
   unsigned stride_,nlist0_,nlist1_,nallpairs_,lastupdate_;
+/// Serial communicator used by the link cells
+  std::unique_ptr<Communicator> serialcomm_;
+/// Link cells used to build the list in O(N) operations
+  std::unique_ptr<LinkCells> linkcells_;
 /// Initialize the neighbor list with all possible pairs
   void initialize();
 /// Return the pair of indexes in the positions array
@@ -49,6 +60,10 @@ class NeighborList
   std::pair<unsigned,unsigned> getIndexPair(unsigned i);
 /// Extract the list of atoms from the current list of close pairs
   void setRequestList();
+/// Check if the list can be built using link cells
+  bool canUseLinkCells() const;
+/// Build the list of close pairs using link cells
+  void updateWithLinkCells(const std::vector<PLMD::Vector>& positions);
 public:
   NeighborList(const std::vector<PLMD::AtomNumber>& list0,
                const std::vector<PLMD::AtomNumber>& list1,
@@ -66,8 +81,15 @@ public:
 /// Update the neighbor list and prepare the new
 /// list of atoms that will be requested to the main code
   void update(const std::vector<PLMD::Vector>& positions);
+/// Check if any atom moved more than half of the skin since the last update
+  bool needsUpdate(const std::vector<PLMD::Vector>& positions) const;
 /// Get the update stride of the neighbor list
   unsigned getStride() const;
+/// Set the skin used to trigger updates based on atomic displacements.
+/// Only meaningful for lists built with a cutoff
+  void setSkin(const double& skin);
+/// Get the skin of the neighbor list
+  double getSkin() const;
 /// Get the last step in which the neighbor list was updated
   unsigned getLastUpdate() const;
 /// Set the step of the last update
@@ -78,7 +100,9 @@ public:
   std::pair<unsigned,unsigned> getClosePair(unsigned i) const;
 /// Get the list of neighbors of the i-th atom
   std::vector<unsigned> getNeighbors(unsigned i);
-  ~NeighborList() {}
+/// Build the neighbor list using link cells whenever pbc are in use
+  void enableLinkCells();
+  ~NeighborList();
 };
 
 }
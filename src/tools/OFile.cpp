@@ -36,6 +36,11 @@
 
 #include <memory>
 #include <utility>
+#include <cstdint>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef __PLUMED_HAS_ZLIB
 #include <zlib.h>
@@ -43,19 +48,164 @@
 
 namespace PLMD {
 
+/// Size in bytes above which the current block of a binary file is written
+static const size_t binaryBlockBytes=1<<20;
+
+/// Append n bytes to a buffer
+static void packRaw(std::vector<char>&buf,const void*p,size_t n) {
+  const char* c=static_cast<const char*>(p);
+  buf.insert(buf.end(),c,c+n);
+}
+
+/// Append a number to a buffer, in native binary format
+template<typename T>
+static void packValue(std::vector<char>&buf,const T&x) {
+  packRaw(buf,&x,sizeof(T));
+}
+
+/// Append a string to a buffer, preceded by its length
+static void packString(std::vector<char>&buf,const std::string&s) {
+  packValue(buf,uint32_t(s.length()));
+  packRaw(buf,s.c_str(),s.length());
+}
+
+class OFile::AsyncWriter {
+/// A piece of data. If flush is true, the file is flushed after writing it
+  struct Chunk {
+    std::vector<char> data;
+    bool flush=false;
+  };
+  OFile& file;
+/// Maximum number of bytes in the queue
+  size_t maxbytes;
+/// Chunks waiting to be written
+  std::deque<Chunk> queue;
+/// Number of bytes in the queue, including the chunk being written
+  size_t queued=0;
+/// True while the thread is writing a chunk
+  bool busy=false;
+  bool stop=false;
+/// Set when a write has failed
+  bool failed=false;
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::thread writer_thread;
+  void run();
+public:
+  AsyncWriter(OFile&file,size_t maxbytes);
+/// Write all the queued data and stop the thread
+  ~AsyncWriter();
+/// Queue data. Waits only if the queue is full
+  void write(const char*,size_t);
+/// Queue a flush, to be done after the data queued so far
+  void flush();
+/// Wait until the queue is empty. Returns false if some write failed
+  bool wait();
+};
+
+/// Small writes are merged in chunks of this size
+static const size_t asyncChunkBytes=1<<16;
+
+OFile::AsyncWriter::AsyncWriter(OFile&file,size_t maxbytes):
+  file(file),
+  maxbytes(maxbytes)
+{
+  writer_thread=std::thread(&AsyncWriter::run,this);
+}
+
+OFile::AsyncWriter::~AsyncWriter() {
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    stop=true;
+  }
+  cv.notify_all();
+  writer_thread.join();
+}
+
+void OFile::AsyncWriter::run() {
+  std::unique_lock<std::mutex> lock(mtx);
+  while(true) {
+    cv.wait(lock,[&] {return stop || !queue.empty();});
+// when stopped, the remaining chunks are written before returning
+    if(queue.empty()) return;
+    Chunk chunk(std::move(queue.front()));
+    queue.pop_front();
+    busy=true;
+    lock.unlock();
+    bool ok=true;
+    if(chunk.data.size()>0) ok=(file.writeNow(chunk.data.data(),chunk.data.size())==chunk.data.size());
+    if(chunk.flush) file.flushNow();
+    lock.lock();
+    if(!ok) failed=true;
+    busy=false;
+    queued-=chunk.data.size();
+    cv.notify_all();
+  }
+}
+
+void OFile::AsyncWriter::write(const char*ptr,size_t n) {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock,[&] {return queued==0 || queued+n<=maxbytes;});
+  if(queue.empty() || queue.back().flush || queue.back().data.size()+n>asyncChunkBytes) queue.emplace_back();
+  queue.back().data.insert(queue.back().data.end(),ptr,ptr+n);
+  queued+=n;
+  cv.notify_all();
+}
+
+void OFile::AsyncWriter::flush() {
+  std::unique_lock<std::mutex> lock(mtx);
+  if(queue.empty() || queue.back().flush) queue.emplace_back();
+  queue.back().flush=true;
+  cv.notify_all();
+}
+
+bool OFile::AsyncWriter::wait() {
+  std::unique_lock<std::mutex> lock(mtx);
+  cv.wait(lock,[&] {return queue.empty() && !busy;});
+  return !failed;
+}
+
+size_t OFile::writeNow(const char*ptr,size_t s) {
+  size_t r;
+  if(gzfp) {
+#ifdef __PLUMED_HAS_ZLIB
+    r=gzwrite(gzFile(gzfp),ptr,s);
+#else
+    plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
+#endif
+  } else {
+    r=fwrite(ptr,1,s,fp);
+  }
+  return r;
+}
+
+void OFile::flushNow() {
+  FileBase::flush();
+  // if(gzfp) gzflush(gzFile(gzfp),Z_FINISH);
+  // for some reason flushing with Z_FINISH has problems on linux
+  // I thus use this (incomplete) flush
+#ifdef __PLUMED_HAS_ZLIB
+  if(gzfp) gzflush(gzFile(gzfp),Z_FULL_FLUSH);
+#endif
+}
+
+void OFile::stopAsync() {
+  if(!async) return;
+  if(!async->wait()) err=true;
+  async.reset();
+}
+
 size_t OFile::llwrite(const char*ptr,size_t s) {
+  std::lock_guard<std::recursive_mutex> lock(mtx);
   size_t r;
   if(linked) return linked->llwrite(ptr,s);
   if(! (comm && comm->Get_rank()>0)) {
     if(!fp) plumed_merror("writing on uninitilized File");
-    if(gzfp) {
-#ifdef __PLUMED_HAS_ZLIB
-      r=gzwrite(gzFile(gzfp),ptr,s);
-#else
-      plumed_merror("file " + getPath() + ": trying to use a gz file without zlib being linked");
-#endif
+    if(async) {
+      async->write(ptr,s);
+      r=s;
     } else {
-      r=fwrite(ptr,1,s,fp);
+      r=writeNow(ptr,s);
     }
   }
 //  This barrier is apparently useless since it comes
@@ -76,7 +226,10 @@ OFile::OFile():
   fieldChanged(false),
   backstring("bck"),
   enforceRestart_(false),
-  enforceBackup_(false)
+  enforceBackup_(false),
+  blockRows(0),
+  blockBytes(0),
+  asyncBytes(0)
 {
   fmtField();
   buflen=1;
@@ -89,6 +242,11 @@ OFile::OFile():
   for(unsigned i=0; i<1000; ++i) buffer_string[i]=0;
 }
 
+OFile::~OFile() {
+  if(binary && !cloned && (fp||gzfp)) writeBinaryBlock();
+  stopAsync();
+}
+
 OFile& OFile::link(OFile&l) {
   fp=NULL;
   gzfp=NULL;
@@ -102,6 +260,7 @@ OFile& OFile::setLinePrefix(const std::string&l) {
 }
 
 int OFile::printf(const char*fmt,...) {
+  std::lock_guard<std::recursive_mutex> lock(mtx);
   va_list arg;
   va_start(arg, fmt);
   int r=std::vsnprintf(&buffer[actual_buffer_length],buflen-actual_buffer_length,fmt,arg);
@@ -128,8 +287,19 @@ int OFile::printf(const char*fmt,...) {
   char*psearch=p1+actual_buffer_length;
   actual_buffer_length+=r;
   while((p2=strchr(psearch,'\n'))) {
-    if(linePrefix.length()>0) llwrite(linePrefix.c_str(),linePrefix.length());
-    llwrite(p1,p2-p1+1);
+    if(binary) {
+// lines are stored as text records, after the rows written so far
+      writeBinaryBlock();
+      std::vector<char> record;
+      packRaw(record,"TEXT",4);
+      packValue(record,uint32_t(linePrefix.length()+(p2-p1+1)));
+      packRaw(record,linePrefix.c_str(),linePrefix.length());
+      packRaw(record,p1,p2-p1+1);
+      llwrite(record.data(),record.size());
+    } else {
+      if(linePrefix.length()>0) llwrite(linePrefix.c_str(),linePrefix.length());
+      llwrite(p1,p2-p1+1);
+    }
     actual_buffer_length-=(p2-p1)+1;
     p1=p2+1;
     psearch=p1;
@@ -163,13 +333,35 @@ OFile& OFile::fmtField() {
   return *this;
 }
 
+bool OFile::isConstantField(const std::string&name)const {
+  for(unsigned i=0; i<const_fields.size(); i++) if(const_fields[i].name==name) return true;
+  return false;
+}
+
 OFile& OFile::printField(const std::string&name,double v) {
+// in binary files numbers are not converted to text, unless they are constant fields
+  if(binary && !isConstantField(name)) {
+    Field field;
+    field.name=name;
+    field.type=typeDouble;
+    field.dvalue=v;
+    fields.push_back(field);
+    return *this;
+  }
   sprintf(buffer_string.get(),fieldFmt.c_str(),v);
   printField(name,buffer_string.get());
   return *this;
 }
 
 OFile& OFile::printField(const std::string&name,int v) {
+  if(binary && !isConstantField(name)) {
+    Field field;
+    field.name=name;
+    field.type=typeInt;
+    field.ivalue=v;
+    fields.push_back(field);
+    return *this;
+  }
   sprintf(buffer_string.get()," %d",v);
   printField(name,buffer_string.get());
   return *this;
@@ -213,13 +405,16 @@ OFile& OFile::printField() {
   if(fieldChanged || fields.size()!=previous_fields.size()) {
     reprint=true;
   } else for(unsigned i=0; i<fields.size(); i++) {
-      if( previous_fields[i].name!=fields[i].name ||
+      if( previous_fields[i].name!=fields[i].name || previous_fields[i].type!=fields[i].type ||
           (fields[i].constant && fields[i].value!=previous_fields[i].value) ) {
         reprint=true;
         break;
       }
     }
-  if(reprint) {
+  if(reprint && binary) {
+    writeBinaryBlock();
+    writeBinaryHeader();
+  } else if(reprint) {
     printf("#! FIELDS");
     for(unsigned i=0; i<fields.size(); i++) printf(" %s",fields[i].name.c_str());
     printf("\n");
@@ -228,14 +423,68 @@ OFile& OFile::printField() {
       printf("\n");
     }
   }
-  for(unsigned i=0; i<fields.size(); i++) printf("%s",fields[i].value.c_str());
-  printf("\n");
+  if(binary) {
+    for(unsigned i=0; i<fields.size(); i++) {
+      std::vector<char> & column(columns[i]);
+      const size_t size=column.size();
+      if(fields[i].type==typeDouble) packValue(column,fields[i].dvalue);
+      else if(fields[i].type==typeInt) packValue(column,int32_t(fields[i].ivalue));
+      else packString(column,fields[i].value);
+      blockBytes+=column.size()-size;
+    }
+    blockRows++;
+    if(blockBytes>=binaryBlockBytes) writeBinaryBlock();
+  } else {
+    for(unsigned i=0; i<fields.size(); i++) printf("%s",fields[i].value.c_str());
+    printf("\n");
+  }
   previous_fields=fields;
   fields.clear();
   fieldChanged=false;
   return *this;
 }
 
+void OFile::writeBinaryMagic() {
+  std::vector<char> record;
+  packRaw(record,binaryMagic,8);
+  packValue(record,int32_t(1));
+  llwrite(record.data(),record.size());
+}
+
+void OFile::writeBinaryHeader() {
+  std::vector<char> record;
+  packRaw(record,"HEAD",4);
+  packValue(record,uint32_t(fields.size()));
+  for(unsigned i=0; i<fields.size(); i++) {
+    packValue(record,int32_t(fields[i].type));
+    packString(record,fields[i].name);
+  }
+  packValue(record,uint32_t(const_fields.size()));
+  for(unsigned i=0; i<const_fields.size(); i++) {
+    packString(record,const_fields[i].name);
+    packString(record,const_fields[i].value);
+  }
+  llwrite(record.data(),record.size());
+  columns.assign(fields.size(),std::vector<char>());
+}
+
+void OFile::writeBinaryBlock() {
+  if(blockRows==0) return;
+  std::vector<char> record;
+  record.reserve(blockBytes+12+8*columns.size());
+  packRaw(record,"BLCK",4);
+  packValue(record,uint32_t(blockRows));
+  packValue(record,uint32_t(columns.size()));
+  for(auto & column : columns) {
+    packValue(record,uint64_t(column.size()));
+    record.insert(record.end(),column.begin(),column.end());
+    column.clear();
+  }
+  llwrite(record.data(),record.size());
+  blockRows=0;
+  blockBytes=0;
+}
+
 void OFile::setBackupString( const std::string& str ) {
   backstring=str;
 }
@@ -291,6 +540,7 @@ OFile& OFile::open(const std::string&path) {
   gzfp=NULL;
   this->path=path;
   this->path=appendSuffix(path,getSuffix());
+  binary=isBinaryPath(path) || isBinaryPath(this->path);
   if(checkRestart()) {
     fp=std::fopen(const_cast<char*>(this->path.c_str()),"a");
     mode="a";
@@ -314,6 +564,23 @@ OFile& OFile::open(const std::string&path) {
 #endif
     }
   }
+  size_t bytes=asyncBytes;
+  if(bytes==0 && std::getenv("PLUMED_ASYNC_OUTPUT")) {
+    unsigned kbytes=0;
+    Tools::convert(std::getenv("PLUMED_ASYNC_OUTPUT"),kbytes);
+    bytes=size_t(kbytes)*1024;
+  }
+// only the first process writes
+  if(bytes>0 && !(comm && comm->Get_rank()>0)) async.reset(new AsyncWriter(*this,bytes));
+  if(binary) {
+// the magic string is written also when appending, files are then
+// read as the concatenation of the pieces written by each run
+    writeBinaryMagic();
+    previous_fields.clear();
+    columns.clear();
+    blockRows=0;
+    blockBytes=0;
+  }
   if(plumed) plumed->insertFile(*this);
   return *this;
 }
@@ -323,6 +590,8 @@ OFile& OFile::rewind() {
 // the reason is that normal rewind does not work when in append mode
 // moreover, we can take a backup of the file
   plumed_assert(fp);
+  if(binary) writeBinaryBlock();
+  sync();
   clearFields();
   if(gzfp) {
 #ifdef __PLUMED_HAS_ZLIB
@@ -343,11 +612,15 @@ OFile& OFile::rewind() {
     gzfp=(void*)gzopen(const_cast<char*>(this->path.c_str()),"w9");
 #endif
   } else fp=std::fopen(const_cast<char*>(path.c_str()),"w");
+  if(binary) writeBinaryMagic();
   return *this;
 }
 
 FileBase& OFile::flush() {
+  std::lock_guard<std::recursive_mutex> lock(mtx);
+  if(binary) writeBinaryBlock();
   if(heavyFlush) {
+    sync();
     if(gzfp) {
 #ifdef __PLUMED_HAS_ZLIB
       gzclose(gzFile(gzfp));
@@ -357,15 +630,38 @@ FileBase& OFile::flush() {
       fclose(fp);
       fp=std::fopen(const_cast<char*>(path.c_str()),"a");
     }
+  } else if(async) {
+    async->flush();
   } else {
-    FileBase::flush();
-    // if(gzfp) gzflush(gzFile(gzfp),Z_FINISH);
-    // for some reason flushing with Z_FINISH has problems on linux
-    // I thus use this (incomplete) flush
+    flushNow();
+  }
+  return *this;
+}
+
+void OFile::close() {
+  if(binary) writeBinaryBlock();
+  stopAsync();
+  FileBase::close();
+}
+
+OFile& OFile::appendFile(const std::string&path) {
+  if(binary) writeBinaryBlock();
+  std::vector<char> buf(1<<16);
+  int n;
 #ifdef __PLUMED_HAS_ZLIB
-    if(gzfp) gzflush(gzFile(gzfp),Z_FULL_FLUSH);
+// gzread also reads plain files
+  gzFile gzf=gzopen(path.c_str(),"r");
+  plumed_massert(gzf,"cannot open file "+path);
+  while((n=gzread(gzf,buf.data(),buf.size()))>0) llwrite(buf.data(),n);
+  gzclose(gzf);
+#else
+  FILE* f=std::fopen(path.c_str(),"r");
+  plumed_massert(f,"cannot open file "+path);
+  while((n=std::fread(buf.data(),1,buf.size(),f))>0) llwrite(buf.data(),n);
+  std::fclose(f);
 #endif
-  }
+// fields are written again before the next line
+  previous_fields.clear();
   return *this;
 }
 
@@ -389,5 +685,15 @@ OFile& OFile::enforceBackup() {
   return *this;
 }
 
+OFile& OFile::enableAsync(size_t maxbytes) {
+  asyncBytes=maxbytes;
+  return *this;
+}
+
+OFile& OFile::sync() {
+  if(async && !async->wait()) err=true;
+  return *this;
+}
+
 
 }
@@ -26,6 +26,7 @@
 #include <vector>
 #include <sstream>
 #include <memory>
+#include <mutex>
 
 namespace PLMD {
 
@@ -80,6 +81,42 @@ keyword. Thus, everytime it is modified, all the headers are repeated in the out
 - most methods return a reference to the OFile itself, to allow chaining many calls on the same line
 (this is similar to << operator in std::ostream)
 
+\section binary-ofile Binary columnar files
+
+If the name of the file has extension pbin (possibly followed by gz) fields are not
+converted to text. The file is instead a sequence of records, each of them starting with a
+four character tag:
+- "PLMD", followed by "COL1" and by the integer 1 (used to detect files written with a different endianness).
+  It is written every time the file is opened, so that files can be concatenated.
+- "HEAD", with the number of variable fields and, for each of them, its type (0 for strings, 1 for doubles
+  and 2 for ints) and its name, followed by the number of constant fields and, for each of them, its name
+  and its value. It is the equivalent of the "#! FIELDS" and "#! SET" lines and is written in the same cases.
+- "BLCK", with the number of rows and of columns in the block followed, for each column, by its size in bytes and by
+  the values of all the rows. Doubles and ints are stored with their native binary representation and strings as their length
+  followed by their characters.
+- "TEXT", with the length and the characters of a line written with printf(), which are ignored when the file is read.
+
+Numbers are written in native format. Names and strings are stored as a 32 bit length followed by their characters,
+whereas record sizes are 32 bit integers, except for column sizes that are 64 bit integers.
+Rows are kept in memory and a block is written when it is large enough, when fields are changed,
+and when the file is flushed or closed. The format set with fmtField() is ignored.
+IFile recognizes these files automatically, and reads them returning exactly the numbers that were written.
+
+\section async-ofile Asynchronous output
+
+After enableAsync() is called, or if the environment variable PLUMED_ASYNC_OUTPUT is set to a size in kilobytes,
+the data are not written by the calling thread. They are copied in a queue and written (and compressed, for gz files)
+by a separate thread, so that the caller only waits when the queue reaches the given size.
+Data and flushes are written in the same order in which they are requested and
+a flush() only asks the thread to flush the file after the preceding data. sync() waits until everything requested so
+far has been done, and is implicitly called by close() and rewind() and before heavy flushes.
+
+\section threads-ofile Writing from multiple threads
+
+printf(), the << operator and flush() can be called concurrently from different threads
+(e.g. on the log, by actions calculated in parallel): each call is completed
+before the next one starts, so that lines written by different threads are not mixed.
+
 \section using-correctly-ofile Using correctly OFile in PLUMED
 
 When a OFile object is used in PLUMED it can be convenient to link() it
@@ -180,6 +217,8 @@ class OFile:
   std::string linePrefix;
 /// Temporary ostringstream for << output
   std::ostringstream oss;
+/// Serializes printf(), << and flush() called from different threads
+  std::recursive_mutex mtx;
 /// The string used for backing up files
   std::string backstring;
 /// Find field index given name
@@ -190,9 +229,38 @@ class OFile:
   bool enforceRestart_;
 /// True if backup behavior (i.e. non restart) should be forced
   bool enforceBackup_;
+/// Values of the rows of the current block of a binary file, column by column
+  std::vector<std::vector<char> > columns;
+/// Number of rows in the current block of a binary file
+  unsigned blockRows;
+/// Number of bytes in the current block of a binary file
+  size_t blockBytes;
+/// Check if name is a constant field
+  bool isConstantField(const std::string&name)const;
+/// Write the magic string at the beginning of a binary file
+  void writeBinaryMagic();
+/// Write the header of a binary file, with names and types of the fields
+  void writeBinaryHeader();
+/// Write the rows stored in the current block of a binary file
+  void writeBinaryBlock();
+/// Writes data in a separate thread
+  class AsyncWriter;
+/// Thread writing the data, if asynchronous output is enabled
+  std::unique_ptr<AsyncWriter> async;
+/// Maximum number of bytes queued for asynchronous output, 0 if disabled
+  size_t asyncBytes;
+/// Write data on the file, from the calling thread
+  size_t writeNow(const char*,size_t);
+/// Flush the file, from the calling thread
+  void flushNow();
+/// Wait for the thread writing the data, if any, and stop it
+  void stopAsync();
 public:
 /// Constructor
   OFile();
+/// Destructor.
+/// Writes the rows of binary files that are still in memory
+  ~OFile();
 /// Allows overloading of link
   using FileBase::link;
 /// Allows overloading of open
@@ -256,16 +324,28 @@ public:
   OFile&rewind();
 /// Flush a file
   virtual FileBase&flush();
+/// Close a file
+  virtual void close();
+/// Append the content of another file, as it is.
+/// It is used to merge files, also binary ones, written by different processes.
+  OFile&appendFile(const std::string&path);
 /// Enforce restart, also if the attached plumed object is not restarting.
 /// Useful for tests
   OFile&enforceRestart();
 /// Enforce backup, even if the attached plumed object is restarting.
   OFile&enforceBackup();
+/// Write data in a separate thread, keeping at most maxbytes of data in memory.
+/// Should be called before open(). Overrides the size set with PLUMED_ASYNC_OUTPUT.
+  OFile&enableAsync(size_t maxbytes);
+/// Wait until all the data and flushes requested so far have been done.
+/// Only needed with asynchronous output
+  OFile&sync();
 };
 
 /// Write using << syntax
 template <class T>
 OFile& operator<<(OFile&of,const T &t) {
+  std::lock_guard<std::recursive_mutex> lock(of.mtx);
   of.oss<<t;
   of.printf("%s",of.oss.str().c_str());
   of.oss.str("");
@@ -35,7 +35,15 @@ unsigned OpenMP::getCachelineSize() {
   return cachelineSize;
 }
 
+/// Number of threads set with OpenMP::setNumThreads()
+static unsigned numThreadsSet=0;
+
+void OpenMP::setNumThreads(unsigned n) {
+  numThreadsSet=n;
+}
+
 unsigned OpenMP::getNumThreads() {
+  if(numThreadsSet>0) return numThreadsSet;
   static unsigned numThreads=1;
   if(std::getenv("PLUMED_NUM_THREADS")) Tools::convert(std::getenv("PLUMED_NUM_THREADS"),numThreads);
   return numThreads;
@@ -49,6 +57,14 @@ unsigned OpenMP::getThreadNum() {
 #endif
 }
 
+unsigned OpenMP::getNumThreadsInTeam() {
+#if defined(_OPENMP)
+  return omp_get_num_threads();
+#else
+  return 1;
+#endif
+}
+
 
 
 }
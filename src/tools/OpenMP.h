@@ -33,9 +33,17 @@ public:
 /// Get number of threads that can be used by openMP
   static unsigned getNumThreads();
 
+/// Set number of threads that can be used by openMP, overriding PLUMED_NUM_THREADS.
+/// Zero restores the default behavior
+  static void setNumThreads(unsigned);
+
 /// Returns a unique thread identification number within the current team
   static unsigned getThreadNum();
 
+/// Returns the number of threads in the current team, which can be smaller than
+/// the requested one (e.g. within nested parallel regions)
+  static unsigned getNumThreadsInTeam();
+
 /// get cacheline size
   static unsigned getCachelineSize();
 
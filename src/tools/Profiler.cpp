@@ -0,0 +1,90 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2017 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+
+#include "Profiler.h"
+#include "OFile.h"
+
+#include <cmath>
+
+namespace PLMD {
+
+unsigned Profiler::getBin(long long int t) {
+  if(t<4) return (t<0?0:t);
+// position of the most significant bit, plus the two following bits
+  unsigned o=0;
+  for(unsigned long long tt=t; tt>1; tt>>=1) o++;
+  unsigned b=4*o+((t>>(o-2))&3);
+  return (b<nbins?b:nbins-1);
+}
+
+long long int Profiler::getBinCenter(unsigned b) {
+  if(b<8) return b;
+  unsigned o=b/4;
+  long long int width=1LL<<(o-2);
+  return (4+b%4)*width+width/2;
+}
+
+void Profiler::Record::add(long long int t) {
+  if(histogram.empty()) histogram.assign(nbins,0);
+  cycles++;
+  total+=t;
+  if(t>max)max=t;
+  if(min>t || cycles==1)min=t;
+  histogram[getBin(t)]++;
+}
+
+long long int Profiler::Record::getPercentile(double p)const {
+  if(cycles==0) return 0;
+  unsigned long long target=std::ceil(p*cycles);
+  if(target==0) target=1;
+  unsigned long long sum=0;
+  unsigned b=0;
+  for(; b<nbins-1; b++) {
+    sum+=histogram[b];
+    if(sum>=target) break;
+  }
+  long long int t=getBinCenter(b);
+  if(t<min) t=min;
+  if(t>max) t=max;
+  return t;
+}
+
+const std::string & Profiler::getLabel(unsigned index)const {
+  for(unsigned i=0; i<nphases; i++) if(records[nphases*index+i].cycles>0) return records[nphases*index+i].label;
+  return records[nphases*index].label;
+}
+
+void Profiler::writeCSV(OFile&ofile,long int step,bool header)const {
+  static const char* phases[nphases]= {"calculate","apply","update"};
+  const double frac=1.0/1000000000.0;
+  if(header) ofile.printf("step,index,label,phase,cycles,total,average,minimum,maximum,p50,p90,p99\n");
+  for(unsigned i=0; i<records.size(); i++) {
+    const Record&r(records[i]);
+    if(r.cycles==0) continue;
+    ofile.printf("%ld,%u,%s,%s,%llu,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f\n",
+                 step,i/nphases,r.label.c_str(),phases[i%nphases],r.cycles,
+                 frac*r.total,frac*r.total/r.cycles,frac*r.min,frac*r.max,
+                 frac*r.getPercentile(0.5),frac*r.getPercentile(0.9),frac*r.getPercentile(0.99));
+  }
+}
+
+}
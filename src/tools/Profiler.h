@@ -0,0 +1,119 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2012-2017 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_Profiler_h
+#define __PLUMED_tools_Profiler_h
+#include <string>
+#include <vector>
+#include <chrono>
+
+namespace PLMD {
+
+class OFile;
+
+/**
+\ingroup TOOLBOX
+Class collecting timing statistics for a set of indexed tasks.
+
+Contrarily to Stopwatch, timers are identified by an integer index
+and by a phase (e.g. calculate, apply or update) so that no string has to be
+built or hashed during the timed loop. Every measurement is also
+accumulated in a logarithmic histogram (four bins per power of two) that
+is used to estimate percentiles without storing the individual samples.
+Statistics can be written at any time as comma separated values
+with writeCSV().
+
+\verbatim
+#include "Profiler.h"
+int main(){
+  Profiler prof;
+  for(int i=0;i<100;i++){
+    prof.start();
+// do calculation
+    prof.stop(Profiler::calculate,0,"loop");
+  }
+  return 0;
+}
+\endverbatim
+*/
+class Profiler {
+public:
+/// Phases that can be timed
+  enum Phase {calculate=0,apply=1,update=2,nphases=3};
+private:
+/// Number of histogram bins (four per power of two, in nanoseconds)
+  static const unsigned nbins=256;
+/// Class to store the statistics of a single timer
+  class Record {
+  public:
+    std::string label;
+    unsigned long long cycles = 0;
+    long long int total = 0;
+    long long int max = 0;
+    long long int min = 0;
+    std::vector<unsigned long long> histogram;
+    void add(long long int t);
+/// Estimate percentile p (between 0 and 1) from the histogram
+    long long int getPercentile(double p)const;
+  };
+/// Records, indexed as nphases*index+phase
+  std::vector<Record> records;
+  std::chrono::time_point<std::chrono::high_resolution_clock> lastStart;
+/// Histogram bin corresponding to a time in nanoseconds
+  static unsigned getBin(long long int t);
+/// Time in nanoseconds corresponding to the center of a histogram bin
+  static long long int getBinCenter(unsigned b);
+public:
+/// Start timing
+  void start();
+/// Stop timing and add the elapsed time to the task with the given index.
+/// The label is only used the first time a task is met
+  void stop(Phase phase,unsigned index,const std::string&label);
+/// Number of tasks (including those that were never timed)
+  unsigned getNumberOfTasks()const {return records.size()/nphases;}
+/// Label of a task
+  const std::string & getLabel(unsigned index)const;
+/// Number of times a task was timed in a given phase
+  unsigned long long getCycles(Phase phase,unsigned index)const {return records[nphases*index+phase].cycles;}
+/// Total time in nanoseconds spent by a task in a given phase
+  long long int getTotal(Phase phase,unsigned index)const {return records[nphases*index+phase].total;}
+/// Write all the collected statistics, one line per task and phase.
+/// If header is true, a header with the name of the columns is written first
+  void writeCSV(OFile&ofile,long int step,bool header)const;
+};
+
+inline
+void Profiler::start() {
+  lastStart=std::chrono::high_resolution_clock::now();
+}
+
+inline
+void Profiler::stop(Phase phase,unsigned index,const std::string&label) {
+  auto t=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now()-lastStart);
+  unsigned i=nphases*index+phase;
+  if(i>=records.size()) records.resize(nphases*(index+1));
+  if(records[i].cycles==0) records[i].label=label;
+  records[i].add(t.count());
+}
+
+}
+
+#endif
@@ -25,6 +25,7 @@
 #include "OpenMP.h"
 #include <vector>
 #include <limits>
+#include <algorithm>
 
 using namespace std;
 namespace PLMD {
@@ -161,6 +162,21 @@ removed in the future. Similarly, the STRETCH keyword is still allowed but has n
 Notice that switching functions defined with the simplified syntax are never stretched
 for backward compatibility. This might change in the future.
 
+Switching functions that are expensive to compute (e.g. MATHEVAL, SMAP or Q) can be replaced by a
+cubic spline interpolating a table of their values and derivatives between \f$d_0\f$ and \f$d_{max}\f$.
+This is done with the TABULATE flag, which requires D_MAX to be set:
+\verbatim
+KEYWORD={MATHEVAL FUNC=1/(1+x^6) R_0=0.3 D_MAX=1.0 TABULATE}
+\endverbatim
+The table is refined until, on 15 equally spaced points inside each interval,
+the maximum error on the switching function is smaller than TABULATE_TOL (default 1e-6) and the maximum error
+on its derivative is smaller than TABULATE_TOL times the largest absolute value of the derivative.
+Since the interpolated derivative is the derivative of the interpolated function, forces remain
+consistent with the tabulated switching function.
+The table is built as a function of the distance rather than of its square, since many switching
+functions (e.g. EXP or SMAP) have a derivative with respect to the squared distance that diverges at zero
+distance and cannot be interpolated accurately there.
+
 */
 //+ENDPLUMEDOC
 
@@ -186,6 +202,8 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
   dmax_2=std::numeric_limits<double>::max();
   stretch=1.0;
   shift=0.0;
+  tabulated=false;
+  tab.clear();
   init=true;
 
   bool present;
@@ -202,6 +220,11 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
   bool dontstretch=false;
   Tools::parseFlag(data,"NOSTRETCH",dontstretch); // this is ignored now
   if(dontstretch) dostretch=false;
+  bool dotabulate=false;
+  Tools::parseFlag(data,"TABULATE",dotabulate);
+  double tabtol=1e-6;
+  present=Tools::findKeyword(data,"TABULATE_TOL");
+  if(present && !Tools::parse(data,"TABULATE_TOL",tabtol)) errormsg="could not parse TABULATE_TOL";
   double r0;
   if(name=="CUBIC") {
     r0 = dmax - d0;
@@ -271,6 +294,62 @@ void SwitchingFunction::set(const std::string & definition,std::string& errormsg
     stretch=1.0/(s0-sd);
     shift=-sd*stretch;
   }
+
+  if(dotabulate) {
+    if(dmax==std::numeric_limits<double>::max()) errormsg="TABULATE requires D_MAX";
+    else if(!buildTable(tabtol)) errormsg="cannot tabulate switching function with TABULATE_TOL="+std::to_string(tabtol);
+  }
+}
+
+bool SwitchingFunction::buildTable(double tol) {
+  tabulated=false;
+  tab_min=(d0>0.0 ? d0 : 0.0);
+  for(unsigned n=64; n<=(1u<<20); n*=2) {
+    const double h=(dmax-tab_min)/n;
+// exact function and its derivative ds/dr.
+// at tab_min the derivative is taken from the right, since calculate() returns zero there
+    auto exact=[&](double r,double&dsdr) {
+      const double rr=(r>tab_min ? r : tab_min+1e-6*h);
+      double df;
+      calculate(rr,df);
+      dsdr=df*rr;
+      return calculate(r,df);
+    };
+    std::vector<double> sv(n+1),dv(n+1);
+    double maxd=0.0;
+    for(unsigned k=0; k<=n; k++) {
+      sv[k]=exact(tab_min+k*h,dv[k]);
+      if(std::fabs(dv[k])>maxd) maxd=std::fabs(dv[k]);
+    }
+// cubic Hermite interpolation, as a polynomial in t=(r-r_i)/h
+    tab.assign(4*n,0.0);
+    for(unsigned i=0; i<n; i++) {
+      tab[4*i+0]=sv[i];
+      tab[4*i+1]=dv[i]*h;
+      tab[4*i+2]=3*(sv[i+1]-sv[i])-(2*dv[i]+dv[i+1])*h;
+      tab[4*i+3]=2*(sv[i]-sv[i+1])+(dv[i]+dv[i+1])*h;
+    }
+    tab_invh=1.0/h;
+// maximum error over a dense set of points inside each interval.
+// the loop stops as soon as the tolerance is exceeded, since the table is then refined
+    const unsigned nsample=16;
+    double maxerr=0.0,maxderr=0.0;
+    for(unsigned i=0; i<n && maxerr<=tol && maxderr<=tol*maxd; i++) for(unsigned q=1; q<nsample; q++) {
+        const double r=tab_min+(i+double(q)/nsample)*h;
+        double dsdr,df;
+        const double s=exact(r,dsdr);
+        const double st=do_table(r,df);
+        maxerr=std::max(maxerr,std::fabs(st-s));
+        maxderr=std::max(maxderr,std::fabs(df*r-dsdr));
+      }
+    if(maxerr<=tol && maxderr<=tol*maxd) {
+      tab_maxerr=maxerr;
+      tabulated=true;
+      return true;
+    }
+  }
+  tab.clear();
+  return false;
 }
 
 std::string SwitchingFunction::description() const {
@@ -308,6 +387,7 @@ std::string SwitchingFunction::description() const {
     ostr<<" func="<<lepton_func;
 
   }
+  if(tabulated) ostr<<" tabulated with "<<tab.size()/4<<" intervals (maximum error "<<tab_maxerr<<")";
   return ostr.str();
 }
 
@@ -336,8 +416,179 @@ double SwitchingFunction::do_rational(double rdist,double&dfunc,int nn,int mm)co
   return result;
 }
 
-double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const {
+/// Same as Tools::fastpow(base[i],exp) for i<n, with n<=SwitchingFunction::batchSize.
+/// Operations are done in the same order so that results are identical,
+/// but the loop on i is the innermost one so that it can be vectorized.
+static void fastpowBatch(unsigned n,const double*base,int exp,double*result) {
+  double b[SwitchingFunction::batchSize];
+  if(exp<0) {
+    exp=-exp;
+    for(unsigned i=0; i<n; i++) b[i]=1.0/base[i];
+  } else {
+    for(unsigned i=0; i<n; i++) b[i]=base[i];
+  }
+  for(unsigned i=0; i<n; i++) result[i]=1.0;
+  while(exp) {
+    if(exp & 1) for(unsigned i=0; i<n; i++) result[i]*=b[i];
+    exp>>=1;
+    for(unsigned i=0; i<n; i++) b[i]*=b[i];
+  }
+}
+
+void SwitchingFunction::do_rational(unsigned n,const double*rdist,double*result,double*dfunc,int nn,int mm)const {
+  double rNdist[batchSize];
+  fastpowBatch(n,rdist,nn-1,rNdist);
+  if(2*nn==mm) {
+    for(unsigned i=0; i<n; i++) {
+      double iden=1.0/(1+rNdist[i]*rdist[i]);
+      dfunc[i] = -nn*rNdist[i]*iden*iden;
+      result[i] = iden;
+    }
+  } else {
+    double rMdist[batchSize];
+    fastpowBatch(n,rdist,mm-1,rMdist);
+    for(unsigned i=0; i<n; i++) {
+// both branches of the scalar version are computed and then selected
+      const bool one=(rdist[i]>(1.-100.0*epsilon) && rdist[i]<(1+100.0*epsilon));
+      double num = 1.-rNdist[i]*rdist[i];
+      double iden = 1./(1.-rMdist[i]*rdist[i]);
+      double func = num*iden;
+      result[i] = (one ? nn/mm : func);
+      dfunc[i] = (one ? 0.5*nn*(nn-mm)/mm : ((-nn*rNdist[i]*iden)+(func*(iden*mm)*rMdist[i])));
+    }
+  }
+}
+
+inline void SwitchingFunction::do_finish(double distance,double rdist,double&result,double&dfunc)const {
+// chain rule, division by distance, short and long distances and stretch, as in calculate().
+// all branches are computed and then selected
+  double df=dfunc*invr0;
+  df/=distance;
+  const bool in=(rdist<=0.);
+  const bool out=(distance>dmax);
+  double res=(in ? 1. : result);
+  df=(in ? 0.0 : df);
+  res=res*stretch+shift;
+  df*=stretch;
+  result=(out ? 0.0 : res);
+  dfunc=(out ? 0.0 : df);
+}
+
+inline double SwitchingFunction::do_table(double distance,double&dfunc)const {
+  if(distance>dmax) {
+    dfunc=0.0;
+    return 0.0;
+  }
+  if(distance<=tab_min) {
+    dfunc=0.0;
+    return tab[0];
+  }
+  const double x=(distance-tab_min)*tab_invh;
+  const unsigned n=tab.size()/4;
+  unsigned i=x;
+  if(i>=n) i=n-1;
+  const double t=x-i;
+  const double*c=&tab[4*i];
+// derivative divided by distance, as in calculate()
+  dfunc=(c[1]+t*(2*c[2]+3*t*c[3]))*tab_invh/distance;
+  return c[0]+t*(c[1]+t*(c[2]+t*c[3]));
+}
+
+void SwitchingFunction::calculateSqr(unsigned n,const double*distance2,double*result,double*dfunc)const {
+  plumed_massert(init,"you are trying to use an unset SwitchingFunction");
+  for(unsigned i=0; i<n; i+=batchSize) do_batch((n-i<batchSize ? n-i : batchSize),distance2+i,result+i,dfunc+i);
+}
+
+void SwitchingFunction::do_batch(unsigned n,const double*distance2,double*result,double*dfunc)const {
+  if(n==0) return;
+  if(tabulated) {
+// the table is a function of the distance (see the documentation above), so the square root is needed
+    for(unsigned i=0; i<n; i++) result[i]=do_table(std::sqrt(distance2[i]),dfunc[i]);
+    return;
+  }
   if(type==rational && nn%2==0 && mm%2==0 && d0==0.0) {
+    double rdist_2[batchSize]= {};
+    for(unsigned i=0; i<n; i++) rdist_2[i]=distance2[i]*invr0_2;
+    do_rational(n,rdist_2,result,dfunc,nn/2,mm/2);
+    for(unsigned i=0; i<n; i++) {
+// chain rule and stretch, as in calculateSqr():
+      double df=dfunc[i]*(2*invr0_2);
+      df*=stretch;
+      const bool out=(distance2[i]>dmax_2);
+      result[i]=(out ? 0.0 : result[i]*stretch+shift);
+      dfunc[i]=(out ? 0.0 : df);
+    }
+    return;
+  }
+
+  if(type==leptontype) {
+// the batch version of evaluate() is thread safe, so the first copy of the expression can be used
+    double distance[batchSize]= {};
+    double rdist[batchSize]= {};
+    for(unsigned i=0; i<n; i++) {
+      distance[i]=std::sqrt(distance2[i]);
+      rdist[i]=(distance[i]-d0)*invr0;
+    }
+    const double* values[1]= {rdist};
+    expression[0].evaluate(n,values,result);
+    expression_deriv[0].evaluate(n,values,dfunc);
+    for(unsigned i=0; i<n; i++) do_finish(distance[i],rdist[i],result[i],dfunc[i]);
+    return;
+  }
+
+  if(type!=rational && type!=exponential && type!=gaussian && type!=cubic && type!=tanh) {
+    for(unsigned i=0; i<n; i++) result[i]=calculateSqr(distance2[i],dfunc[i]);
+    return;
+  }
+
+  if(type==rational) {
+    double distance[batchSize]= {};
+    double rdist[batchSize]= {};
+    for(unsigned i=0; i<n; i++) {
+      distance[i]=std::sqrt(distance2[i]);
+      rdist[i]=(distance[i]-d0)*invr0;
+    }
+    do_rational(n,rdist,result,dfunc,nn,mm);
+    for(unsigned i=0; i<n; i++) do_finish(distance[i],rdist[i],result[i],dfunc[i]);
+  } else if(type==exponential) {
+    for(unsigned i=0; i<n; i++) {
+      const double distance=std::sqrt(distance2[i]);
+      const double rdist=(distance-d0)*invr0;
+      result[i]=exp(-rdist);
+      dfunc[i]=-result[i];
+      do_finish(distance,rdist,result[i],dfunc[i]);
+    }
+  } else if(type==gaussian) {
+    for(unsigned i=0; i<n; i++) {
+      const double distance=std::sqrt(distance2[i]);
+      const double rdist=(distance-d0)*invr0;
+      result[i]=exp(-0.5*rdist*rdist);
+      dfunc[i]=-rdist*result[i];
+      do_finish(distance,rdist,result[i],dfunc[i]);
+    }
+  } else if(type==cubic) {
+    for(unsigned i=0; i<n; i++) {
+      const double distance=std::sqrt(distance2[i]);
+      const double rdist=(distance-d0)*invr0;
+      double tmp1=rdist-1, tmp2=(1+2*rdist);
+      result[i]=tmp1*tmp1*tmp2;
+      dfunc[i]=2*tmp1*tmp2 + 2*tmp1*tmp1;
+      do_finish(distance,rdist,result[i],dfunc[i]);
+    }
+  } else if(type==tanh) {
+    for(unsigned i=0; i<n; i++) {
+      const double distance=std::sqrt(distance2[i]);
+      const double rdist=(distance-d0)*invr0;
+      double tmp1=std::tanh(rdist);
+      result[i] = 1.0 - tmp1;
+      dfunc[i]=-(1-tmp1*tmp1);
+      do_finish(distance,rdist,result[i],dfunc[i]);
+    }
+  }
+}
+
+double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const {
+  if(!tabulated && type==rational && nn%2==0 && mm%2==0 && d0==0.0) {
     if(distance2>dmax_2) {
       dfunc=0.0;
       return 0.0;
@@ -358,6 +609,7 @@ double SwitchingFunction::calculateSqr(double distance2,double&dfunc)const {
 
 double SwitchingFunction::calculate(double distance,double&dfunc)const {
   plumed_massert(init,"you are trying to use an unset SwitchingFunction");
+  if(tabulated) return do_table(distance,dfunc);
   if(distance>dmax) {
     dfunc=0.0;
     return 0.0;
@@ -423,6 +675,8 @@ double SwitchingFunction::calculate(double distance,double&dfunc)const {
 void SwitchingFunction::set(int nn,int mm,double r0,double d0) {
   init=true;
   type=rational;
+  tabulated=false;
+  tab.clear();
   if(mm==0) mm=2*nn;
   this->nn=nn;
   this->mm=mm;
@@ -439,6 +693,10 @@ void SwitchingFunction::set(int nn,int mm,double r0,double d0) {
   shift=-sd*stretch;
 }
 
+bool SwitchingFunction::isTabulated() const {
+  return tabulated;
+}
+
 double SwitchingFunction::get_r0() const {
   return 1./invr0;
 }
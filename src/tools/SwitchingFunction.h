@@ -73,6 +73,27 @@ class SwitchingFunction {
 /// Low-level tool to compute rational functions.
 /// It is separated since it is called both by calculate() and calculateSqr()
   double do_rational(double rdist,double&dfunc,int nn,int mm)const;
+/// Same as do_rational(), for n distances at once (n<=batchSize).
+  void do_rational(unsigned n,const double*rdist,double*result,double*dfunc,int nn,int mm)const;
+/// Same as calculateSqr(unsigned,const double*,double*,double*), for n<=batchSize.
+  void do_batch(unsigned n,const double*distance2,double*result,double*dfunc)const;
+/// Last part of calculate(), applied by do_batch() to the function and derivative computed at rdist.
+  void do_finish(double distance,double rdist,double&result,double&dfunc)const;
+/// True if the function is computed by interpolating a table
+  bool tabulated=false;
+/// Minimum distance in the table (d0, or zero if d0 is negative)
+  double tab_min=0.0;
+/// Inverse of the spacing of the table
+  double tab_invh=0.0;
+/// Maximum error of the table on the switching function, as measured when it was built
+  double tab_maxerr=0.0;
+/// Coefficients of the cubic polynomial in each interval of the table, four per interval
+  std::vector<double> tab;
+/// Build the table, refining it until the interpolation error is smaller than tol.
+/// Returns false if the required accuracy cannot be reached
+  bool buildTable(double tol);
+/// Compute the switching function interpolating the table
+  double do_table(double distance,double&dfunc)const;
 /// Function for lepton;
   std::string lepton_func;
 /// Lepton expression.
@@ -104,6 +125,16 @@ public:
 /// The advantage is that in some case the expensive square root can be avoided
 /// (namely for rational functions, if nn and mm are even and d0 is zero)
   double calculateSqr(double distance2,double&dfunc)const;
+/// Compute the switching function for n squared distances at once.
+/// Results are identical to those of calculateSqr(), but the functional form
+/// is only checked once and, for rational, exponential, gaussian, cubic and tanh functions,
+/// the loops on distances are written so that they can be vectorized by the compiler.
+  void calculateSqr(unsigned n,const double*distance2,double*result,double*dfunc)const;
+/// Number of distances processed at once by the batch version of calculateSqr().
+/// Callers collecting distances in fixed size buffers can use it as buffer size.
+  static const unsigned batchSize=64;
+/// Returns true if the switching function is computed by interpolating a table
+  bool isTabulated() const;
 /// Returns d0
   double get_d0() const;
 /// Returns r0
@@ -0,0 +1,166 @@
+/* +++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+   Copyright (c) 2018 The plumed team
+   (see the PEOPLE file at the root of the distribution for a list of names)
+
+   See http://www.plumed.org for more information.
+
+   This file is part of plumed, version 2.
+
+   plumed is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Lesser General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   plumed is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Lesser General Public License for more details.
+
+   You should have received a copy of the GNU Lesser General Public License
+   along with plumed.  If not, see <http://www.gnu.org/licenses/>.
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++ */
+#ifndef __PLUMED_tools_ThreadReduction_h
+#define __PLUMED_tools_ThreadReduction_h
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace PLMD {
+
+/**
+\ingroup TOOLBOX
+Class to sum contributions computed by several OpenMP threads to the elements of an array.
+
+Instead of giving each thread a private copy of the whole array, each thread only stores
+the (index,value) pairs it has computed. The array is split in as many contiguous blocks as the
+number of threads and every pair is stored in the list of the block containing its index.
+When the loop is over, each thread sums into the final array the lists of one block,
+coming from all threads. In this way memory and time are proportional to the number
+of contributions rather than to the size of the array times the number of threads,
+and the final sum is done in parallel without critical sections.
+Consecutive contributions to the same index are merged on the fly.
+
+Since a pair takes more memory than an element of the array, a thread that stores more
+pairs than the size of the array times sizeof(T)/sizeof(pair) moves its contributions to a private
+copy of the array, and then adds to it directly. Memory used by each thread is thus never
+larger than that of a private copy of the array.
+
+The object can be kept across steps, so as to reuse the memory of the lists.
+\verbatim
+ThreadReduction<Vector> reduction;
+reduction.resize(nt,deriv.size());
+#pragma omp parallel num_threads(nt)
+{
+  const unsigned t=OpenMP::getThreadNum();
+  #pragma omp for
+  for(unsigned i=0; i<n; i++) {
+    ...
+    reduction.add(t,j,dd);
+  }
+// the implicit barrier at the end of the loop is needed here
+  reduction.sum(t,OpenMP::getNumThreadsInTeam(),&deriv[0]);
+}
+\endverbatim
+*/
+template<typename T>
+class ThreadReduction {
+/// Contributions of a single thread
+  struct ThreadData {
+/// Pairs, indexed by block
+    std::vector<std::vector<std::pair<unsigned,T> > > lists;
+/// Private copy of the array, only used when dense is true
+    std::vector<T> values;
+/// Number of pairs stored in lists
+    size_t npairs=0;
+/// True if contributions are added to values rather than stored in lists
+    bool dense=false;
+/// Padding, so that counters of different threads are not in the same cache line
+    char padding[64];
+  };
+/// Number of threads
+  unsigned nthreads=0;
+/// Size of the array
+  unsigned size=0;
+/// Size of each block
+  unsigned blocksize=1;
+/// Maximum number of pairs stored by a thread before moving to a private copy of the array
+  size_t maxpairs=0;
+/// Contributions, indexed by thread
+  std::vector<ThreadData> threads;
+/// Move the contributions stored in lists to the private copy of the array
+  void makeDense(ThreadData&);
+public:
+/// Prepare for nthreads threads, contributing to an array with size elements
+  void resize(unsigned nthreads,unsigned size);
+/// Add value to element index. To be called by thread number thread
+  void add(unsigned thread,unsigned index,const T& value);
+/// Sum all the contributions to the elements of the blocks assigned to thread into result, and clear them.
+/// Blocks are assigned cyclically to the nteam threads of the team, which could be less than the
+/// number passed to resize(). To be called by every thread after all of them have finished calling add()
+  void sum(unsigned thread,unsigned nteam,T* result);
+};
+
+template<typename T>
+void ThreadReduction<T>::resize(unsigned nthreads,unsigned size) {
+  if(nthreads!=this->nthreads || size!=this->size) threads.clear();
+  this->nthreads=nthreads;
+  this->size=size;
+  blocksize=(size+nthreads-1)/nthreads;
+  if(blocksize==0) blocksize=1;
+  maxpairs=(size_t(size)*sizeof(T))/sizeof(std::pair<unsigned,T>);
+  threads.resize(nthreads);
+  for(auto & t : threads) t.lists.resize(nthreads);
+}
+
+template<typename T>
+void ThreadReduction<T>::makeDense(ThreadData& data) {
+  data.values.assign(size,T());
+  for(auto & list : data.lists) {
+    for(const auto & e : list) data.values[e.first]+=e.second;
+// memory of the lists is released, since they will not be used anymore
+    std::vector<std::pair<unsigned,T> >().swap(list);
+  }
+  data.npairs=0;
+  data.dense=true;
+}
+
+template<typename T>
+inline
+void ThreadReduction<T>::add(unsigned thread,unsigned index,const T& value) {
+  ThreadData & data(threads[thread]);
+  if(data.dense) {
+    data.values[index]+=value;
+    return;
+  }
+  std::vector<std::pair<unsigned,T> > & list(data.lists[index/blocksize]);
+  if(!list.empty() && list.back().first==index) list.back().second+=value;
+  else {
+    list.push_back(std::pair<unsigned,T>(index,value));
+    if(++data.npairs>maxpairs) makeDense(data);
+  }
+}
+
+template<typename T>
+void ThreadReduction<T>::sum(unsigned thread,unsigned nteam,T* result) {
+// counters are reset with the same cyclic assignment used for blocks
+  for(unsigned t=thread; t<nthreads; t+=nteam) threads[t].npairs=0;
+  for(unsigned b=thread; b<nthreads; b+=nteam) for(unsigned t=0; t<nthreads; t++) {
+      ThreadData & data(threads[t]);
+      if(data.dense) {
+        const unsigned last=(b+1)*blocksize<size ? (b+1)*blocksize : size;
+        for(unsigned i=b*blocksize; i<last; i++) {
+          result[i]+=data.values[i];
+          data.values[i]=T();
+        }
+      } else {
+        std::vector<std::pair<unsigned,T> > & list(data.lists[b]);
+        for(const auto & e : list) result[e.first]+=e.second;
+        list.clear();
+      }
+    }
+}
+
+}
+
+#endif
@@ -307,19 +307,11 @@ void BF_Custom::getAllValues(const double arg, double& argT, bool& inside_range,
   double transf_derivf=1.0;
   //
   if(do_transf_) {
-    // has to copy as the function is const
-    lepton::CompiledExpression ce_value = transf_value_expression_;
-    try {
-      ce_value.getVariableReference(transf_variable_str_) = argT;
-    } catch(PLMD::lepton::Exception& exc) {}
-
-    lepton::CompiledExpression ce_deriv = transf_deriv_expression_;
-    try {
-      ce_deriv.getVariableReference(transf_variable_str_) = argT;
-    } catch(PLMD::lepton::Exception& exc) {}
-
-    argT = ce_value.evaluate();
-    transf_derivf = ce_deriv.evaluate();
+    // the batch version of evaluate() does not modify the expressions
+    const double argT_in = argT;
+    const double* transf_args[1] = {&argT_in};
+    transf_value_expression_.evaluate(1,transf_args,&argT);
+    transf_deriv_expression_.evaluate(1,transf_args,&transf_derivf);
 
     if(check_nan_inf_ && (std::isnan(argT) || std::isinf(argT)) ) {
       std::string vs; Tools::convert(argT,vs);
@@ -334,18 +326,10 @@ void BF_Custom::getAllValues(const double arg, double& argT, bool& inside_range,
   //
   values[0]=1.0;
   derivs[0]=0.0;
+  const double* bf_args[1] = {&argT};
   for(unsigned int i=1; i < getNumberOfBasisFunctions(); i++) {
-    lepton::CompiledExpression ce_value = bf_values_expressions_[i];
-    try {
-      ce_value.getVariableReference(variable_str_) = argT;
-    } catch(PLMD::lepton::Exception& exc) {}
-    values[i] = ce_value.evaluate();
-
-    lepton::CompiledExpression ce_deriv = bf_derivs_expressions_[i];
-    try {
-      ce_deriv.getVariableReference(variable_str_) = argT;
-    } catch(PLMD::lepton::Exception& exc) {}
-    derivs[i] = ce_deriv.evaluate();
+    bf_values_expressions_[i].evaluate(1,bf_args,&values[i]);
+    bf_derivs_expressions_[i].evaluate(1,bf_args,&derivs[i]);
     if(do_transf_) {derivs[i]*=transf_derivf;}
     // NaN checks
     if(check_nan_inf_ && (std::isnan(values[i]) || std::isinf(values[i])) ) {
@@ -191,6 +191,8 @@ public:
   void apply() {};
   void calculate() {};
   void update();
+/// Results depend on the previous frames
+  bool isHistoryDependent()const {return true;}
   unsigned int getNumberOfDerivatives() {return 0;}
   //
   bool fixedStepSize() const {return fixed_stepsize_;}
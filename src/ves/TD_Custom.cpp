@@ -28,6 +28,8 @@
 
 #include "lepton/Lepton.h"
 
+#include <algorithm>
+
 
 namespace PLMD {
 namespace ves {
@@ -242,33 +244,39 @@ void TD_Custom::updateGrid() {
   if(use_fes_) {
     plumed_massert(getFesGridPntr()!=NULL,"the FES grid has to be linked to the free energy in the target distribution");
   }
-  if(use_kbt_) {
-    try {
-      expression.getVariableReference(kbt_var_str_) = 1.0/getBeta();
-    } catch(PLMD::lepton::Exception& exc) {}
-  }
-  if(use_beta_) {
-    try {
-      expression.getVariableReference(beta_var_str_) = getBeta();
-    } catch(PLMD::lepton::Exception& exc) {}
-  }
   //
   std::vector<double> integration_weights = GridIntegrationWeights::getIntegrationWeights(getTargetDistGridPntr());
   double norm = 0.0;
   //
-  for(Grid::index_t l=0; l<targetDistGrid().getSize(); l++) {
-    std::vector<double> point = targetDistGrid().getPoint(l);
-    for(unsigned int k=0; k<cv_var_str_.size() ; k++) {
-      try {
-        expression.getVariableReference(cv_var_str_[k]) = point[cv_var_idx_[k]];
-      } catch(PLMD::lepton::Exception& exc) {}
+  // the expression is evaluated on the whole grid at once, with one column of values for each variable
+  const Grid::index_t size = targetDistGrid().getSize();
+  const std::set<std::string>& variables = expression.getVariables();
+  std::vector<std::vector<double> > columns(variables.size(),std::vector<double>(size));
+  std::vector<const double*> columns_ptr(variables.size());
+  unsigned int i=0;
+  for(const auto & var : variables) {
+    std::vector<double>& column = columns[i];
+    columns_ptr[i++] = column.data();
+    if(use_kbt_ && var==kbt_var_str_) {
+      for(Grid::index_t l=0; l<size; l++) {column[l] = 1.0/getBeta();}
+    }
+    else if(use_beta_ && var==beta_var_str_) {
+      for(Grid::index_t l=0; l<size; l++) {column[l] = getBeta();}
     }
-    if(use_fes_) {
-      try {
-        expression.getVariableReference(fes_var_str_) = getFesGridPntr()->getValue(l);
-      } catch(PLMD::lepton::Exception& exc) {}
+    else if(use_fes_ && var==fes_var_str_) {
+      for(Grid::index_t l=0; l<size; l++) {column[l] = getFesGridPntr()->getValue(l);}
     }
-    double value = expression.evaluate();
+    else {
+      unsigned int k = std::find(cv_var_str_.begin(),cv_var_str_.end(),var) - cv_var_str_.begin();
+      plumed_massert(k<cv_var_str_.size(),"unknown variable "+var+" in the target distribution function");
+      for(Grid::index_t l=0; l<size; l++) {column[l] = targetDistGrid().getPoint(l)[cv_var_idx_[k]];}
+    }
+  }
+  std::vector<double> values(size);
+  expression.evaluate(size,columns_ptr.data(),values.data());
+  //
+  for(Grid::index_t l=0; l<size; l++) {
+    double value = values[l];
 
     if(value<0.0 && !isTargetDistGridShiftedToZero()) {plumed_merror(getName()+": The target distribution function gives negative values. You should change the definition of the function used for the target distribution to avoid this. You can also use the SHIFT_TO_ZERO keyword to avoid this problem.");}
     targetDistGrid().setValue(l,value);
@@ -79,6 +79,8 @@ public:
 /// Overwrite ActionWithArguments getArguments() so that we don't return the bias
   std::vector<Value*> getArguments();
   void update();
+/// Results depend on the previous frames
+  bool isHistoryDependent()const {return true;}
 /// This does the clearing of the action
   virtual void clearAverage();
 /// This is done before the averaging comences
@@ -30,6 +30,7 @@
 #include "StoreDataVessel.h"
 #include "tools/OpenMP.h"
 #include "tools/Stopwatch.h"
+#include <algorithm>
 
 using namespace std;
 namespace PLMD {
@@ -261,10 +262,26 @@ void ActionWithVessel::runAllTasks() {
   doJobsRequiredBeforeTaskList();
   if(timers) stopwatch.stop("1 Prepare Tasks");
 
+  // Get the tasks for this process. Tasks are distributed round robin, unless their costs
+  // are known: in that case each process gets a contiguous range with the same total cost
+  unsigned tbegin=rank, tend=nactive_tasks, tstride=stride;
+  if( stride>1 && hasTaskCosts() ) {
+    std::vector<double> cumulative( nactive_tasks+1, 0.0 );
+    for(unsigned i=0; i<nactive_tasks; ++i) cumulative[i+1]=cumulative[i]+getTaskCost( partialTaskList[i] );
+    const double total=cumulative[nactive_tasks];
+    tbegin=std::lower_bound( cumulative.begin(), cumulative.end()-1, rank*total/stride ) - cumulative.begin();
+    tend=( rank+1==stride ? nactive_tasks : std::lower_bound( cumulative.begin(), cumulative.end()-1, (rank+1)*total/stride ) - cumulative.begin() );
+    tstride=1;
+  }
+  const unsigned nlocal=( tend>tbegin ? (tend-tbegin+tstride-1)/tstride : 0 );
+
   // Get number of threads for OpenMP
   unsigned nt=OpenMP::getNumThreads();
-  if( nt*stride*10>nactive_tasks ) nt=nactive_tasks/stride/10;
+  if( nt*10>nlocal ) nt=nlocal/10;
   if( nt==0 || !threadSafe() ) nt=1;
+  // Tasks are given to threads dynamically, in chunks small enough to balance tasks with different costs
+  unsigned chunk=nlocal/(16*nt);
+  if( chunk==0 ) chunk=1;
 
   // Get size for buffer
   unsigned bsize=0, bufsize=getSizeOfBuffer( bsize );
@@ -279,16 +296,21 @@ void ActionWithVessel::runAllTasks() {
   // std::vector<double> buffer( bufsize, 0.0 );
 
   if(timers) stopwatch.start("2 Loop over tasks");
+  // Thread zero uses buffer, the other threads use their own zeroed buffers
+  if( omp_buffers.size()<nt ) omp_buffers.resize( nt );
+  for(unsigned t=1; t<nt; ++t) {
+    if( omp_buffers[t].size()!=bufsize ) omp_buffers[t].assign( bufsize, 0.0 );
+  }
   #pragma omp parallel num_threads(nt)
   {
-    std::vector<double> omp_buffer;
-    if( nt>1 ) omp_buffer.resize( bufsize, 0.0 );
+    const unsigned t=OpenMP::getThreadNum();
+    std::vector<double>& omp_buffer( t==0 ? buffer : omp_buffers[t] );
     MultiValue myvals( getNumberOfQuantities(), getNumberOfDerivatives() );
     MultiValue bvals( getNumberOfQuantities(), getNumberOfDerivatives() );
     myvals.clearAll(); bvals.clearAll();
 
-    #pragma omp for nowait
-    for(unsigned i=rank; i<nactive_tasks; i+=stride) {
+    #pragma omp for schedule(dynamic,chunk)
+    for(unsigned i=tbegin; i<tend; i+=tstride) {
       // Calculate the stuff in the loop for this action
       performTask( indexOfTaskInFullList[i], partialTaskList[i], myvals );
 
@@ -304,17 +326,19 @@ void ActionWithVessel::runAllTasks() {
       // Now calculate all the functions
       // If the contribution of this quantity is very small at neighbour list time ignore it
       // untill next neighbour list time
-      if( nt>1 ) {
-        calculateAllVessels( indexOfTaskInFullList[i], myvals, bvals, omp_buffer, der_list );
-      } else {
-        calculateAllVessels( indexOfTaskInFullList[i], myvals, bvals, buffer, der_list );
-      }
+      calculateAllVessels( indexOfTaskInFullList[i], myvals, bvals, omp_buffer, der_list );
 
       // Clear the value
       myvals.clearAll();
     }
-    #pragma omp critical
-    if(nt>1) for(unsigned i=0; i<bufsize; ++i) buffer[i]+=omp_buffer[i];
+    // Sum the buffers in parallel, each thread taking care of a block of elements,
+    // and clear them for the next step
+    if( nt>1 ) {
+      #pragma omp for
+      for(unsigned i=0; i<bufsize; ++i) {
+        for(unsigned j=1; j<nt; ++j) { buffer[i]+=omp_buffers[j][i]; omp_buffers[j][i]=0.0; }
+      }
+    }
   }
   if(timers) stopwatch.stop("2 Loop over tasks");
   // Turn back on derivative calculation
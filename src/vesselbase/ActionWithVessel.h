@@ -85,6 +85,9 @@ private:
   std::vector<unsigned> der_list;
 /// The buffer that we use (we keep a copy here to avoid resizing)
   std::vector<double> buffer;
+/// Buffers used by the OpenMP threads other than the first one, which uses buffer.
+/// They are kept to avoid resizing and are set back to zero while they are summed.
+  std::vector<std::vector<double> > omp_buffers;
 /// Do we want to output information on the timings of different parts of the calculation
   bool timers;
   ForwardDecl<Stopwatch> stopwatch_fwd;
@@ -178,6 +181,11 @@ public:
   unsigned getActiveTask( const unsigned& ii ) const ;
 /// Calculate one of the functions in the distribution
   virtual void performTask( const unsigned&, const unsigned&, MultiValue& ) const=0;
+/// Do the tasks have different costs that can be estimated with getTaskCost()
+  virtual bool hasTaskCosts() const { return false; }
+/// Estimate the relative cost of the task with a given code. This is used to give each MPI process
+/// a contiguous range of tasks with the same total cost, and must thus be the same on all processes
+  virtual double getTaskCost( const unsigned& current ) const { return 1.0; }
 /// Do the task if we have a bridge
   virtual void transformBridgedDerivatives( const unsigned& current, MultiValue& invals, MultiValue& outvals ) const;
 /// Ensure that data required in other vessels is stored